@@ -3,11 +3,16 @@
  *
  *	Copyright (c) 1986 by Andy Valencia
  */
+#include <stdio.h>
 #include "fpcommon.h"
 #include "ast.h"
 #include "yystype.h"
 #include "ast.hpp"
+#include "misc.h"
 #include "obj.h"
+#include "object.hpp"
+#include "symtab_entry.hpp"
+#include "y.tab.h"
 
 #ifdef MEMSTAT
 int ast_out = 0;
@@ -28,6 +33,17 @@ ast_alloc(int atag, ast_ptr l, ast_ptr m, ast_ptr r)
     return( p );
 }
 
+/// Get an 'i' node, to run the intrinsic sym
+live_ast_ptr
+ast_intrinsic(live_sym_ptr sym)
+{
+    assert(sym->sym_fn);
+    auto p = ast_alloc('i');
+    p->val.YYsym = sym;
+    p->fn = sym->sym_fn;
+    return(p);
+}
+
 /// Free a node
 static void
 ast_free(ast_ptr p)
@@ -49,3 +65,169 @@ ast_freetree(ast_ptr p)
 	obj_unref( (p->val).YYobj );
     ast_free(p);
 }
+
+/// Copy a whole tree
+live_ast_ptr
+ast_copy(live_ast_ptr p)
+{
+    auto q = ast_alloc(p->tag);
+    q->val = p->val;
+    q->fn = p->fn;
+    if( p->tag == '%' )
+	q->val.YYobj->inc_ref();
+    if( p->left )
+	q->left = ast_copy(p->live_left());
+    if( p->middle )
+	q->middle = ast_copy(p->live_middle());
+    if( p->right )
+	q->right = ast_copy(p->live_right());
+    return(q);
+}
+
+/// Count the nodes of a tree
+int
+ast_size(ast_ptr p)
+{
+    if( !p ) return(0);
+    return( 1 + ast_size(p->left) + ast_size(p->middle) + ast_size(p->right) );
+}
+
+/// Print an operand of & ! | or %, with parentheses if it needs them
+static void
+ast_prarg(live_ast_ptr p)
+{
+    const bool paren = (p->tag == '@');
+    if( paren ) putchar('(');
+    ast_print(p);
+    if( paren ) putchar(')');
+}
+
+/// Print the stages of a pipeline from s on, the last applied first
+static void
+ast_prstages(live_ast_ptr s)
+{
+    if( s->right ){
+	ast_prstages(s->live_right());
+	putchar('@');
+    }
+    switch( s->tag ){
+    case 'm':
+	putchar('&');
+	ast_prarg(s->live_left());
+	return;
+    case 'f':
+	printf("concat@&");
+	ast_prarg(s->live_left());
+	return;
+    }
+    printf("concat@&(");
+    ast_print(s->live_left());
+    printf(" -> ");
+    if( s->tag == 'K' )
+	ast_print(s->live_middle());
+    else {
+	putchar('[');
+	if( s->middle )
+	    ast_print(s->live_middle());
+	else
+	    printf("id");
+	putchar(']');
+    }
+    printf(" ; %%<>)");
+}
+
+    /*
+     * Print a tree back out as FP source, for seeing what the rewriter
+     *	did.  Nodes the parser never makes print as what they stand for.
+     */
+void
+ast_print(live_ast_ptr p)
+{
+    switch( p->tag ){
+    case 'i':
+    case 'U':
+	printf("%s", p->val.YYsym->sym_pname.c_str());
+	break;
+    case 'S':
+	printf("%d", p->val.YYint);
+	break;
+    case 'D':
+	printf("(tl");
+	for( int x = 1; x < p->val.YYint; ++x )
+	    printf("@tl");
+	putchar(')');
+	break;
+    case 'c':
+	switch( p->val.YYint ){
+	case NE: printf("~="); break;
+	case LE: printf("<="); break;
+	case GE: printf(">="); break;
+	default: putchar(p->val.YYint); break;
+	}
+	break;
+    case '%':
+	putchar('%');
+	obj_prtree(p->val.YYobj);
+	break;
+    case '@':
+	if( p->live_left()->tag == '@' ){
+	    putchar('(');
+	    ast_print(p->live_left());
+	    putchar(')');
+	} else
+	    ast_print(p->live_left());
+	putchar('@');
+	ast_print(p->live_right());
+	break;
+    case '[':
+	putchar('[');
+	for( ast_ptr q = p->left; q; q = q->right ){
+	    ast_print(q->live_left());
+	    if( q->right ) printf(", ");
+	}
+	putchar(']');
+	break;
+    case '>':
+	putchar('(');
+	ast_print(p->live_left());
+	printf(" -> ");
+	ast_print(p->live_middle());
+	printf(" ; ");
+	ast_print(p->live_right());
+	putchar(')');
+	break;
+    case '&':
+    case '!':
+    case '|':
+	putchar(p->tag);
+	ast_prarg(p->live_left());
+	break;
+    case 'W':
+	printf("(while ");
+	ast_print(p->live_left());
+	putchar(' ');
+	ast_print(p->live_right());
+	putchar(')');
+	break;
+    case 'P':
+	putchar('(');
+	if( p->right ){
+	    ast_print(p->live_right());
+	    putchar('@');
+	}
+	ast_prstages(p->live_left());
+	if( p->middle ){
+	    putchar('@');
+	    ast_print(p->live_middle());
+	}
+	putchar(')');
+	break;
+    case 'V':
+	putchar('(');
+	ast_print(p->live_left());
+	putchar(')');
+	break;
+    default:
+	fatal_err("Undefined AST tag in ast_print()");
+    }
+}
@@ -2,6 +2,14 @@
 #define AST_H
 
 live_ast_ptr ast_alloc(int atag, ast_ptr l = nullptr, ast_ptr m = nullptr, ast_ptr r = nullptr);
+/// ast_intrinsic()--an 'i' node running a builtin
+live_ast_ptr ast_intrinsic(live_sym_ptr sym);
 void ast_freetree(ast_ptr p);
+/// ast_copy()--a copy of a whole tree
+live_ast_ptr ast_copy(live_ast_ptr p);
+/// ast_size()--how many nodes a tree has
+int ast_size(ast_ptr p);
+/// ast_print()--print a tree as FP source
+void ast_print(live_ast_ptr p);
 
 #endif
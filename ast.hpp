@@ -8,6 +8,8 @@ struct ast final {
     ast_ptr left = nullptr;
     ast_ptr middle = nullptr;
     ast_ptr right = nullptr;
+    /// An 'i' node's handler, looked up once when the node is made
+    intrinsic_fn fn = nullptr;
     
     live_ast_ptr live_left()
     {
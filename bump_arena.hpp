@@ -0,0 +1,97 @@
+#ifndef BUMP_ARENA_HPP
+#define BUMP_ARENA_HPP
+
+#include <stddef.h>
+#include <new>
+
+/**
+ * A region which hands out memory by bumping a pointer through large
+ *	chunks, and takes it all back at once with reset().  Nothing is
+ *	freed piecemeal.  Chunks are kept across a reset for the next
+ *	round; a request too big to share a chunk gets a block of its own,
+ *	which reset() does give back.
+ */
+template <size_t CHUNK_SIZE = 1024 * 1024>
+struct bump_arena final {
+    /// Everything handed out is aligned to this
+    static constexpr size_t ALIGN = 8;
+
+    bump_arena() = default;
+    bump_arena(const bump_arena &) = delete;
+    bump_arena &operator=(const bump_arena &) = delete;
+
+    /// Hand out n bytes, good until the next reset()
+    void * _Nonnull alloc(size_t n)
+    {
+        n = (n + ALIGN - 1) & ~(ALIGN - 1);
+        if( n > static_cast<size_t>(end - next) )
+            return refill(n);
+        auto p = next;
+        next += n;
+        used += n;
+        return p;
+    }
+
+    /// Take back everything handed out so far
+    void reset()
+    {
+        while( big ){
+            auto b = big;
+            big = b->next;
+            ::operator delete(b);
+        }
+        current = nullptr;
+        next = end = nullptr;
+        used = 0;
+    }
+
+    /// Bytes handed out since the last reset()
+    size_t bytes_used() const
+    {
+        return used;
+    }
+
+private:
+    /// The header of a chunk or a big block
+    struct block {
+        block * _Nullable next;
+    };
+    static constexpr size_t HEADER = (sizeof(block) + ALIGN - 1) & ~(ALIGN - 1);
+
+    /// Carry on in the next chunk, getting one if need be
+    void * _Nonnull refill(size_t n)
+    {
+        used += n;
+        if( n > CHUNK_SIZE / 4 ){
+            auto b = static_cast<block *>(::operator new(HEADER + n));
+            b->next = big;
+            big = b;
+            return reinterpret_cast<char *>(b) + HEADER;
+        }
+        auto c = current ? current->next : chunks;
+        if( !c ){
+            c = static_cast<block *>(::operator new(CHUNK_SIZE));
+            c->next = nullptr;
+            if( current )
+                current->next = c;
+            else
+                chunks = c;
+        }
+        current = c;
+        next = reinterpret_cast<char *>(c) + HEADER + n;
+        end = reinterpret_cast<char *>(c) + CHUNK_SIZE;
+        return reinterpret_cast<char *>(c) + HEADER;
+    }
+
+    /// All the chunks ever got, in the order they are used
+    block * _Nullable chunks = nullptr;
+    /// The one being bumped through
+    block * _Nullable current = nullptr;
+    /// Blocks for requests too big for a chunk
+    block * _Nullable big = nullptr;
+    char * _Nullable next = nullptr;
+    char * _Nullable end = nullptr;
+    size_t used = 0;
+};
+
+#endif
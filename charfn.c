@@ -3,18 +3,58 @@
  *
  * 	Copyright (c) 1986 by Andy Valencia
  */
+#include <algorithm>
 #include "fpcommon.h"
 #include "yystype.h"
 #include "ast.hpp"
 #include "charfn.h"
+#include "list.h"
 #include "misc.h"
 #include "obj.h"
 #include "object.hpp"
+#include "list_iter.hpp"
 #include "y.tab.h"
 
+static bool same(obj_ptr o1, obj_ptr o2);
+
+    /*
+     * same_list()--tell whether two lists hold the same elements.  Lists
+     *	of different lengths or hashes are told apart without a walk; the
+     *	hashes are cached, so a list compared again costs nothing extra.
+     */
+static bool
+same_list(live_obj_ptr l1, live_obj_ptr l2)
+{
+    if( l1->list_length() != l2->list_length() )
+        return(false);
+    if( list_hash(l1) != list_hash(l2) )
+        return(false);
+
+	// Unboxed vectors of one kind compare straight from their stores
+    if( l1->is_packed() && l2->is_packed() &&
+        l1->vec_store()->kind == l2->vec_store()->kind ){
+        auto s1 = l1->vec_store();
+        auto s2 = l2->vec_store();
+        const auto x1 = l1->vec_offset();
+        const auto x2 = l2->vec_offset();
+        const auto n = l1->vec_length();
+        if( s1->kind == store_kind::INTS )
+            return std::equal(s1->ints() + x1, s1->ints() + x1 + n, s2->ints() + x2);
+        return std::equal(s1->doubles() + x1, s1->doubles() + x1 + n, s2->doubles() + x2);
+    }
+
+    list_iter i1{l1};
+    list_iter i2{l2};
+    for( ; !i1.done(); i1.next(), i2.next() ){
+        if( !same(i1.elem(), i2.elem()) )
+            return(false);
+    }
+    return(true);
+}
+
     /*
      * same()--looks at two objects and tells whether they are the same.
-     *	We recurse if it is a list.
+     *	We recurse only into lists nested inside lists.
      */
 static bool
 same(obj_ptr o1, obj_ptr o2)
@@ -23,6 +63,9 @@ same(obj_ptr o1, obj_ptr o2)
         return(true);
     assert(o1);
     assert(o2);
+	// A vector and a cons chain can hold the same list
+    if( o1->is_list() && o2->is_list() )
+        return same_list(static_cast<live_obj_ptr>(o1), static_cast<live_obj_ptr>(o2));
     if( o1->type() != o2->type() ){
         if( o1->is_int() )
             if( o2->is_float() )
@@ -40,7 +83,8 @@ same(obj_ptr o1, obj_ptr o2)
         case obj_type::T_FLOAT:
             return( o1->float_val() == o2->float_val() );
         case obj_type::T_LIST:
-            return( same(o1->car(),o2->car()) && same(o1->cdr(),o2->cdr()) );
+        case obj_type::T_VECTOR:
+            fatal_err("Lists not caught in same()");
         case obj_type::T_UNDEF:
             fatal_err("Bad AST type in same()");
     }
@@ -64,176 +108,82 @@ eqobj(live_obj_ptr obj)
     return(p);
 }
 
-/// noteqobj()--just like eqobj(), but not equal
-static live_obj_ptr
-noteqobj(live_obj_ptr obj)
+/// The numeric type a binary function of p and q works in, if any
+static pair_type
+numtype(live_obj_ptr p, live_obj_ptr q)
 {
-    assert(obj);
-    auto p = eqobj(obj);
-
-    if( p->is_bool() ) {
-        const bool old = p->bool_val();
-        p->bool_val(!old);
-    }
-    return(p);
+    if( !p->is_num() || !q->is_num() ) return(pair_type::T_UNDEF);
+    if( (p->is_float()) || (q->is_float()) )
+	return(pair_type::T_FLOAT);
+    return(pair_type::T_INT);
 }
 
-/// do_charfun()--execute the action of a binary function
+    /*
+     * charfn()--apply the binary function op to p and q, which stay the
+     *	caller's.  This is the work of do_charfun() without the pair.
+     */
 live_obj_ptr
-do_charfun(live_ast_ptr act, live_obj_ptr obj)
+charfn(int op, live_obj_ptr p, live_obj_ptr q)
 {
-    assert(act);
-    assert(obj);
-
-    switch( (act->val).YYint ){
-
-    case '=': {
-        return( eqobj(obj) );
-    }
-    case NE: {
-        return( noteqobj(obj) );
+    switch( op ){
+    case '=':
+        return obj_alloc(same(p, q));
+    case NE:
+        return obj_alloc(!same(p, q));
     }
 
+    const auto type = numtype(p, q);
+    if( type == pair_type::T_UNDEF )
+        return undefined();
+    switch( op ){
     case '>':
-	switch( pairtype(obj) ){
-        case pair_type::T_UNDEF: {
-            obj_unref(obj);
-            return undefined();
-        }
-        case pair_type::T_FLOAT:
-        case pair_type::T_INT: {
-            const bool result = obj->car()->num_val() > obj->cadr()->num_val();
-            auto p = obj_alloc(result);
-            obj_unref(obj);
-            return(p);
-        }
-	}
-
+        return obj_alloc(p->num_val() > q->num_val());
     case GE:
-	switch( pairtype(obj) ){
-        case pair_type::T_UNDEF: {
-            obj_unref(obj);
-            return undefined();
-        }
-        case pair_type::T_FLOAT:
-        case pair_type::T_INT: {
-            const bool result = obj->car()->num_val() >= obj->cadr()->num_val();
-            auto p = obj_alloc(result);
-            obj_unref(obj);
-            return(p);
-        }
-	}
-
+        return obj_alloc(p->num_val() >= q->num_val());
     case LE:
-	switch( pairtype(obj) ){
-        case pair_type::T_UNDEF: {
-            obj_unref(obj);
-            return undefined();
-        }
-        case pair_type::T_FLOAT:
-        case pair_type::T_INT: {
-            const bool result = obj->car()->num_val() <= obj->cadr()->num_val();
-            auto p = obj_alloc(result);
-            obj_unref(obj);
-            return(p);
-        }
-	}
-
+        return obj_alloc(p->num_val() <= q->num_val());
     case '<':
-	switch( pairtype(obj) ){
-        case pair_type::T_UNDEF: {
-            obj_unref(obj);
-            return undefined();
-        }
-        case pair_type::T_FLOAT:
-        case pair_type::T_INT: {
-            const bool result = obj->car()->num_val() < obj->cadr()->num_val();
-            auto p = obj_alloc(result);
-            obj_unref(obj);
-            return(p);
-        }
-	}
-
+        return obj_alloc(p->num_val() < q->num_val());
     case '+':
-	switch( pairtype(obj) ){
-        case pair_type::T_UNDEF: {
-            obj_unref(obj);
-            return undefined();
-        }
-        case pair_type::T_FLOAT: {
-            const auto value = obj->car()->num_val()+obj->cadr()->num_val();
-            auto p = obj_alloc(value);
-            obj_unref(obj);
-            return(p);
-        }
-        case pair_type::T_INT: {
-            const int value = obj->car()->int_val()+obj->cadr()->int_val();
-            auto p = obj_alloc(value);
-            obj_unref(obj);
-            return(p);
-        }
-	}
+        if( type == pair_type::T_FLOAT )
+            return obj_alloc(p->num_val() + q->num_val());
+        return obj_alloc(p->int_val() + q->int_val());
     case '-':
-	switch( pairtype(obj) ){
-        case pair_type::T_UNDEF: {
-            obj_unref(obj);
-            return undefined();
-        }
-        case pair_type::T_FLOAT: {
-            const auto value = obj->car()->num_val()-obj->cadr()->num_val();
-            auto p = obj_alloc(value);
-            obj_unref(obj);
-            return(p);
-        }
-        case pair_type::T_INT: {
-            const int value = obj->car()->int_val()-obj->cadr()->int_val();
-            auto p = obj_alloc(value);
-            obj_unref(obj);
-            return(p);
-        }
-	}
+        if( type == pair_type::T_FLOAT )
+            return obj_alloc(p->num_val() - q->num_val());
+        return obj_alloc(p->int_val() - q->int_val());
     case '*':
-	switch( pairtype(obj) ){
-        case pair_type::T_UNDEF:
-            obj_unref(obj);
-            return undefined();
-        case pair_type::T_FLOAT: {
-            const auto value = obj->car()->num_val()*obj->cadr()->num_val();
-            auto p = obj_alloc(value);
-            obj_unref(obj);
-            return(p);
-        }
-        case pair_type::T_INT: {
-            const int value = obj->car()->int_val()*obj->cadr()->int_val();
-            auto p = obj_alloc(value);
-            obj_unref(obj);
-            return(p);
-        }
-	}
-    case '/':
-	switch( pairtype(obj) ){
-        case pair_type::T_UNDEF: {
-            obj_unref(obj);
-            return undefined();
-        }
-        case pair_type::T_FLOAT:
-        case pair_type::T_INT: {
-            const auto f = obj->cadr()->num_val();
-            if( f == 0.0 ){
-            obj_unref(obj);
+        if( type == pair_type::T_FLOAT )
+            return obj_alloc(p->num_val() * q->num_val());
+        return obj_alloc(p->int_val() * q->int_val());
+    case '/': {
+        const auto f = q->num_val();
+        if( f == 0.0 )
             return undefined();
-            }
-            const auto value = obj->car()->num_val()/f;
-            auto p = obj_alloc(value);
-            obj_unref(obj);
-            return(p);
-        }
-	}
+        return obj_alloc(p->num_val() / f);
+    }
     default:
 	fatal_err("Undefined charop tag in execute()");
     }
 }
 
+/// do_charfun()--execute the action of a binary function
+live_obj_ptr
+do_charfun(live_ast_ptr act, live_obj_ptr obj)
+{
+    assert(act);
+    assert(obj);
+    if( !obj->is_pair() ){
+        obj_unref(obj);
+        return undefined();
+    }
+    auto p = static_cast<live_obj_ptr>(obj->car());
+    auto q = static_cast<live_obj_ptr>(obj->cadr());
+    auto result = charfn(act->val.YYint, p, q);
+    obj_unref(obj);
+    return(result);
+}
+
     /*
      * pairtype()--process a list which is to be used as a pair of numeric
      *	arguments to a function.
@@ -250,15 +200,6 @@ pairtype(live_obj_ptr obj)
     assert(obj);
     // Don't have a well-formed list, so illegal
     if( !obj->is_pair() ) return(pair_type::T_UNDEF);
-
-	/*
-	 * So it's a list of two.  Verify type of both elements.
-	 *	'p' gets the first object, 'q' gets second.
-	 */
-    obj_ptr p = obj->car();
-    obj_ptr q = obj->cadr();
-    if( !p->is_num() || !q->is_num() ) return(pair_type::T_UNDEF);
-    if( (p->is_float()) || (q->is_float()) )
-	return(pair_type::T_FLOAT);
-    return(pair_type::T_INT);
+    return numtype(static_cast<live_obj_ptr>(obj->car()),
+                   static_cast<live_obj_ptr>(obj->cadr()));
 }
@@ -4,6 +4,8 @@
 #include "pair_type.hpp"
 
 live_obj_ptr do_charfun(live_ast_ptr act, live_obj_ptr obj);
+/// charfn()--binary function op of p and q, which stay the caller's
+live_obj_ptr charfn(int op, live_obj_ptr p, live_obj_ptr q);
 live_obj_ptr eqobj(live_obj_ptr obj);
 pair_type pairtype(live_obj_ptr obj);
 
@@ -0,0 +1,113 @@
+/*
+ * depth.cpp--keep deep recursion from crashing FP
+ *
+ *	The VM keeps calls of user functions on a stack of its own on the
+ *	heap; depth_limit() caps how deep that may get.  What still recurses
+ *	in C--the tree walker, and functional forms applying functions
+ *	within functions--checks stack_exhausted() on the way in.  Either
+ *	way, going too deep gives ? and a message rather than a segfault.
+ *	Each thread par.cpp starts has a C stack, and so a floor, of its own.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+#include <sys/resource.h>
+#include "fpcommon.h"
+#include "depth.h"
+#include "obj.h"
+
+    /*
+     * Default limit on nested calls of user functions.  Override with
+     *	-DMAX_DEPTH=n, or )depth n.
+     */
+#ifndef MAX_DEPTH
+#define MAX_DEPTH 10000000
+#endif
+
+/// C stack kept back for whatever runs past the last check
+static constexpr size_t STACK_RESERVE = 256 * 1024;
+/// C stack assumed when the system won't say
+static constexpr size_t STACK_DEFAULT = 8 * 1024 * 1024;
+
+static unsigned max_depth = MAX_DEPTH;
+
+/// Size of the main thread's C stack, and of every other thread's
+static size_t stack_size = STACK_DEFAULT;
+
+/// This thread's C stack may not grow below this address; 0 until set
+static thread_local uintptr_t stack_floor = 0;
+
+/// Whether this application has said it went too deep
+static std::atomic<bool> complained{false};
+
+/// An interrupt wants every application in progress to give up
+static std::atomic<bool> abandoned{false};
+
+void
+depth_init(void)
+{
+    struct rlimit rl;
+    if( getrlimit(RLIMIT_STACK, &rl) == 0 && rl.rlim_cur != RLIM_INFINITY )
+        stack_size = static_cast<size_t>(rl.rlim_cur);
+    if( stack_size < 2 * STACK_RESERVE )
+        stack_size = 2 * STACK_RESERVE;
+    depth_thread();
+}
+
+void
+depth_thread(void)
+{
+    char here;
+    stack_floor = reinterpret_cast<uintptr_t>(&here) - (stack_size - STACK_RESERVE);
+}
+
+unsigned long
+depth_stack(void)
+{
+    return(stack_size);
+}
+
+unsigned
+depth_limit(void)
+{
+    return(max_depth);
+}
+
+void
+depth_set(unsigned calls)
+{
+    if( calls )
+        max_depth = calls;
+    printf("Calls may nest %u deep\n", max_depth);
+}
+
+bool
+stack_exhausted(void)
+{
+    char here;
+    return( reinterpret_cast<uintptr_t>(&here) < stack_floor ||
+            abandoned.load(std::memory_order_relaxed) );
+}
+
+live_obj_ptr
+too_deep(live_obj_ptr obj)
+{
+    if( !complained.exchange(true) )
+        printf("Recursion too deep\n");
+    obj_unref(obj);
+    return undefined();
+}
+
+void
+depth_abandon(void)
+{
+    complained = true;
+    abandoned = true;
+}
+
+void
+depth_reset(void)
+{
+    complained = false;
+    abandoned = false;
+}
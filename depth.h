@@ -0,0 +1,24 @@
+#ifndef DEPTH_H
+#define DEPTH_H
+
+//depth.cpp
+/// depth_init()--note where the C stack starts, and how far it may grow
+void depth_init(void);
+/// depth_thread()--note where the C stack of a newly started thread starts
+void depth_thread(void);
+/// depth_stack()--how big a C stack each thread should have, in bytes
+unsigned long depth_stack(void);
+/// depth_limit()--how deep calls of user functions may nest
+unsigned depth_limit(void);
+/// depth_set()--change that, or just show it if calls is 0
+void depth_set(unsigned calls);
+/// stack_exhausted()--true if the C stack is too near its end to go deeper
+bool stack_exhausted(void);
+/// too_deep()--drop obj and give ?, saying why once per application
+live_obj_ptr too_deep(live_obj_ptr obj);
+/// depth_abandon()--make every application in progress give ? as soon as it can
+void depth_abandon(void);
+/// depth_reset()--a new application is starting
+void depth_reset(void);
+
+#endif
@@ -7,436 +7,395 @@
 #include "exec.h"
 #include "yystype.h"
 #include "ast.hpp"
-#include "intrin.h"
 #include "misc.h"
 #include "charfn.h"
+#include "depth.h"
+#include "intrin.h"
+#include "list.h"
+#include "math_intrinsics.h"
+#include "memo.h"
+#include "vector_ops.h"
 #include "obj.h"
 #include "object.hpp"
+#include "list_builder.hpp"
+#include "list_iter.hpp"
 #include "symtab_entry.hpp"
+#include "forms.hpp"
 #include "y.tab.h"
 
-static live_obj_ptr invoke(live_sym_ptr def, live_obj_ptr obj);
-static live_obj_ptr do_rinsert(live_ast_ptr act, live_obj_ptr obj);
-static live_obj_ptr do_binsert(live_ast_ptr act, live_obj_ptr obj);
+// Out of line, so their locals don't weigh on each level of execute()
+[[gnu::noinline]] static live_obj_ptr do_construct(live_ast_ptr act, live_obj_ptr obj);
+[[gnu::noinline]] static live_obj_ptr do_form(live_ast_ptr act, live_obj_ptr obj);
+[[gnu::noinline]] static live_obj_ptr do_memo(live_sym_ptr def, live_obj_ptr obj);
 
     /*
      * Given an AST for an action, and an object to do the action upon,
-     *	execute the action and return the result.
+     *	execute the action and return the result.  An action whose
+     *	result is that of another--a user function, the last step of a
+     *	composition, the arm of a conditional taken--loops back round
+     *	with that one rather than calling itself, so a recursion in those
+     *	places runs in constant stack.
      */
 live_obj_ptr
 execute(live_ast_ptr act, live_obj_ptr obj )
 {
-    assert(act);
+    if( stack_exhausted() )
+        return too_deep(obj);
+    while( 1 ){
+        assert(act);
 
-	// Broad categories of executable entities
-    switch( act->tag ){
-
-	// Invoke a user-defined function
-    case 'U': {
-        assert(act->val.YYsym);
-        return( invoke(act->val.YYsym, obj) );
-    }
+	    // Broad categories of executable entities
+        switch( act->tag ){
 
-	// Right-insert operator
-    case '!': {
-        return( do_rinsert(act->live_left(), obj) );
-    }
+	    // Invoke a user-defined function
+        case 'U': {
+            assert(act->val.YYsym);
+            auto def = static_cast<live_sym_ptr>(act->val.YYsym);
+            if( !def->is_defined() ){
+                printf("%s: undefined\n",def->sym_pname.c_str());
+                obj_unref(obj);
+                return( undefined() );
+            }
+            if( def->sym_memo )
+                return( do_memo(def, obj) );
+                // Calls in tail position loop here, so check again
+            if( stack_exhausted() )
+                return too_deep(obj);
+            act = def->body();
+            continue;
+        }
 
-	// Binary-insert operator
-    case '|': {
-        return( do_binsert(act->live_left(), obj) );
-    }
+	    // Right-insert, binary-insert, apply to all, while and pipelines
+        case '!':
+        case '|':
+        case '&':
+        case 'W':
+        case 'P':
+            return( do_form(act, obj) );
 
-	// Intrinsics
-    case 'i': {
-        assert(act->val.YYsym);
-        return( do_intrinsics(act->val.YYsym, obj) );
-    }
+	    // Linear algebra: a kernel if it takes obj, else as written
+        case 'V': {
+            if( auto p = vec_idiom(act, obj) )
+                return(p);
+            act = act->live_left();
+            continue;
+        }
 
-	// Select one element from a list
-    case 'S': {
-        if(
-            (!obj->is_list()) ||
-            !obj->car()
-        ){
-            obj_unref(obj);
-            return undefined();
+	    // Intrinsics
+        case 'i': {
+            assert(act->fn);
+            return( act->fn(obj) );
         }
-        auto p = obj;
-        int x = act->val.YYint;
-        if( x == 0 ){
-            obj_unref(obj);
-            return undefined();
+
+	    // Select one element from a list
+        case 'S': {
+            return( do_select(act->val.YYint, obj) );
         }
 
-            // Negative selectors count from end of list
-        if( x < 0 ){
-            const int tmp = p->list_length();
+	    // Drop elements from the front of a list (tl@tl@...)
+        case 'D': {
+            return( do_drop(act->val.YYint, obj) );
+        }
 
-            x += (tmp+1);
-            if( x < 0 ){
-            obj_unref(obj);
-            return undefined();
+	    /*
+	     * Apply the action on the left to the result of executing
+	     *	the action on the right against the object.
+	     */
+        case '@': {
+                // &op@trans and friends go straight over unboxed vectors
+            if( auto form = vec_map_form(act) ){
+                auto right = act->live_right();
+                if( right->tag == '@' )
+                    obj = execute(right->live_right(), obj);
+                auto live_form = static_cast<live_ast_ptr>(form);
+                if( auto p = vec_map_pair(act->live_left(), live_form, obj) )
+                    return(static_cast<live_obj_ptr>(p));
+                obj = execute(live_form, obj);
+                act = act->live_left();
+                continue;
             }
+            obj = execute(act->live_right(), obj );
+            act = act->live_left();
+            continue;
         }
-        while( --x ){		// Scan down list X times
-            if( !p ) break;
-            p = p->cdr();
-        }
-        if( !p ){		// Fell off bottom of list
-            obj_unref(obj);
-            return undefined();
+
+	    /*
+	     * Build a new list by applying the listed actions to the object
+	     *	All is complicated by the fact that we must be clean in
+	     *	the presence of T_UNDEF popping up along the way.
+	     */
+        case '[':{
+            return( do_construct(act, obj) );
         }
-        p = p->car();
-        p->inc_ref();		// Add reference to this elem
-        obj_unref(obj);		// Unreference list as a whole
-        return(p);
-    }
 
-	/*
-	 * Apply the action on the left to the result of executing
-	 *	the action on the right against the object.
-	 */
-    case '@': {
-        auto p = execute(act->live_right(), obj );
-        return( execute(act->live_left(), p ) );
-    }
+	    // These are the single-character operations (+, -, etc.)
+        case 'c': {
+            return(do_charfun(act,obj));
+        }
 
-	/*
-	 * Build a new list by applying the listed actions to the object
-	 *	All is complicated by the fact that we must be clean in
-	 *	the presence of T_UNDEF popping up along the way.
-	 */
-    case '[':{
-        act = act->live_left();
-        obj_ptr hd = nullptr;
-        obj_ptr *hdp = &hd;
-        while( act ){
+	    // Conditional.  Evaluate & return one of the two paths
+        case '>': {
             obj->inc_ref();
-            auto left = act->live_left();
-            auto p = execute(left,obj);
+            auto p = execute(act->live_left(),obj);
             if( p->is_undef() ){
-                obj_unref(hd);
                 obj_unref(obj);
                 return(p);
             }
-            auto q = obj_alloc(p);
-            *hdp = q;
-            hdp = q->cdr_addr();
-            act = act->right;
+            if( !p->is_bool() ){
+                obj_unref(obj);
+                obj_unref(p);
+                return undefined();
+            }
+            if( p->bool_val() )
+                act = act->live_middle();
+            else
+                act = act->live_right();
+            obj_unref(p);
+            continue;
         }
-        obj_unref(obj);
-        assert(hd);
-        auto result = static_cast<live_obj_ptr>(hd);
-        return(result);
-    }
 
-	// These are the single-character operations (+, -, etc.)
-    case 'c': {
-        return(do_charfun(act,obj));
-    }
-
-	// Conditional.  Evaluate & return one of the two paths
-    case '>': {
-        obj->inc_ref();
-        auto p = execute(act->live_left(),obj);
-        if( p->is_undef() ){
+	    // Introduce an object
+        case '%': {
+            if( obj->is_undef() ) return(obj);
             obj_unref(obj);
+            auto p = act->val.YYobj;
+            p->inc_ref();
             return(p);
         }
-        if( !p->is_bool() ){
-            obj_unref(obj);
-            obj_unref(p);
-            return undefined();
-        }
-        live_obj_ptr q;
-        if( p->bool_val() ) {
-            auto middle = act->live_middle();
-            q = execute(middle,obj);
-        }
-        else {
-            auto right = act->live_right();
-            q = execute(right,obj);
+
+        default:
+	    fatal_err("Undefined AST tag in execute()");
         }
-        obj_unref(p);
-        return(q);
     }
+}
+
+/// The forms which apply a function over and over
+static live_obj_ptr
+do_form(live_ast_ptr act, live_obj_ptr obj)
+{
+    if( act->tag == 'P' )
+        return( form_pipeline(act, obj,
+                              [](live_ast_ptr f, live_obj_ptr x){ return execute(f, x); }) );
+    auto fn = act->live_left();
+    auto apply = [fn](live_obj_ptr x){ return execute(fn, x); };
+    switch( act->tag ){
+
+	// Right-insert operator
+    case '!':
+        return( form_rinsert(fn, obj, apply) );
+
+	// Binary-insert operator
+    case '|':
+        return( form_binsert(act, obj, apply) );
 
 	// Apply the action to each member of a list
-    case '&': {
-        if( !obj->is_list() ){
-            obj_unref(obj);
-            return undefined();
-        }
-        if( !obj->car() ) return(obj);
-        obj_ptr hd = nullptr;
-        auto hdp = &hd;
-        for(auto p = obj; p; p = p->cdr() ){
-            (p->car())->inc_ref();
-            auto left = act->live_left();
-            assert(p->car());
-            auto p_car = static_cast<live_obj_ptr>(p->car());
-            auto q = execute(left, p_car);
-            if( q->is_undef() ){
-            obj_unref(hd);
-            obj_unref(obj);
-            return(q);
-            }
-            auto r = obj_alloc(q);
-            *hdp = r;
-            hdp = r->cdr_addr();
-        }
-        obj_unref(obj);
-        assert(hd);
-        auto result = static_cast<live_obj_ptr>(hd);
-        return(result);
-    }
+    case '&':
+        return( form_map(fn, obj, apply) );
 
-	// Introduce an object
-    case '%': {
-        if( obj->is_undef() ) return(obj);
-        obj_unref(obj);
-        auto p = act->val.YYobj;
-        p->inc_ref();
-        return(p);
-    }
-    
 	// Do a while loop
     case 'W': {
-        while( 1 ){
-            if( obj->is_undef() ){
-                break;
-            }
-            obj->inc_ref();
-            auto left = act->live_left();
-            auto p = execute(left,obj);
-            if( !p->is_bool() ){
-                obj_unref(p);
-                break;
-            }
-            if( p->bool_val() ){
-                obj_unref(p);
-                auto right = act->live_right();
-                obj = execute(right,obj);
-            } else {
-                obj_unref(p);
-                return(obj);
-            }
-        }
-        obj_unref(obj);
-        return undefined();
+        auto body = act->live_right();
+        return( form_while(obj, apply,
+                           [body](live_obj_ptr x){ return execute(body, x); }) );
     }
-
-    default:
-	fatal_err("Undefined AST tag in execute()");
     }
+    fatal_err("Undefined AST tag in do_form()");
 }
 
-/// Call a previously-defined user function, or error
+/// A call of a function whose results are kept
 static live_obj_ptr
-invoke(live_sym_ptr def, live_obj_ptr obj)
+do_memo(live_sym_ptr def, live_obj_ptr obj)
 {
-    // Must be a defined function
-    if( !def->is_defined() ){
-        printf("%s: undefined\n",def->sym_pname.c_str());
+    if( auto p = memo_lookup(def, obj) ){
         obj_unref(obj);
-        return( undefined() );
+        return static_cast<live_obj_ptr>(p);
     }
-    
-    // Call it with the object
-    return( execute( def->sym_val.YYast, obj ) );
+    obj->inc_ref();
+    auto result = execute(def->body(), obj);
+    memo_store(def, obj, result);
+    obj_unref(obj);
+    return(result);
 }
 
-/// Local function to handle the tedious right-inserting
-static live_obj_ptr
-do_rinsert(live_ast_ptr act, live_obj_ptr obj)
+bool
+quick_form(live_ast_ptr act)
 {
-    if( !obj->is_list() ){
-        obj_unref(obj);
-        return undefined();
+    switch( act->tag ){
+    case 'i':
+        return( !intrin_prints(act->val.YYsym) );
+    case 'S':
+    case 'D':
+    case 'c':
+    case '%':
+        return(true);
     }
+    return(false);
+}
 
-	/*
-	 * If the list is empty, then we need to look at the applied
-	 *	operator.  If it's one for which we have an identity,
-	 *	return the identity.  Otherwise, undefined.  Bletch.
-	 */
-    if( !obj->car() ){
-        obj_unref(obj);
-        live_obj_ptr result;
-        if( act->tag == 'c' ){
-            switch( act->val.YYint ){
-            case '+':
-            case '-':
-            result = obj_alloc(0);
-            break;
-            case '/':
-            case '*':
-            result = obj_alloc(1);
-            break;
-            default:
-            return undefined();
-            }
-        } else if ( act->tag == 'i' ){
-            switch( (act->val.YYsym)->sym_val.YYint ){
-            case AND:
-            result = obj_alloc(true);
-            break;
-            case OR:
-            case XOR:
-            result = obj_alloc(false);
-            break;
-            default:
-            return undefined();
-            }
-        } else return undefined();
-        return(result);
+bool
+may_print(ast_ptr act)
+{
+    if( !act )
+        return(false);
+    switch( act->tag ){
+    case 'i':
+        return( intrin_prints(act->val.YYsym) );
+    case 'U':
+        return( !static_cast<live_sym_ptr>(act->val.YYsym)->silent() );
     }
+    return( may_print(act->left) || may_print(act->middle) || may_print(act->right) );
+}
 
-	// If the list has only one element, we return that element.
-    auto p = obj->cdr();
-    if( !p ){
-        p = obj->car();
-        p->inc_ref();
-        obj_unref(obj);
-        return(p);
+    /*
+     * Construction: [f1, ..., fn]:x is <f1:x ... fn:x>.  The last
+     *	function run gets our own reference to x, so if nobody else holds
+     *	x it may update x in place.  When all the functions but one are
+     *	quick ones, and that one can't print, the quick ones run first and
+     *	the other one last; this is what lets apndr@[f@tlr,last] reuse
+     *	its list.  The quick ones always finish and print nothing, so the
+     *	order can't be seen.  With two or more slow ones, par.cpp may run
+     *	them all at once instead.
+     */
+static live_obj_ptr
+do_construct(live_ast_ptr cons, live_obj_ptr obj)
+{
+    auto act = cons->live_left();
+    ast_ptr slow = nullptr;
+    unsigned n = 0, slows = 0;
+    for( ast_ptr a = act; a; a = a->right ){
+        ++n;
+        if( quick_form(a->live_left()) )
+            continue;
+        slow = (slows++ ? nullptr : a);
+    }
+    if( slows > 1 ){
+        if( auto size = par_fork(cons, obj) ){
+            std::vector<live_ast_ptr> fns;
+            for( ast_ptr a = act; a; a = a->right )
+                fns.push_back(a->live_left());
+            return form_par_construct(cons, n, size, obj,
+                                      [&fns](unsigned x, live_obj_ptr p){ return execute(fns[x], p); });
+        }
     }
 
-	// If the list has two elements, we apply our operator and reduce
-    if( !p->cdr() ){
-        return( execute(act,obj) );
+	// Run the quick ones after the slow one first
+    ast_ptr stop = slow ? slow->right : nullptr;
+    if( stop && may_print(slow->left) )
+        stop = nullptr;
+    list_builder early;
+    for( ast_ptr a = stop; a; a = a->right ){
+        obj->inc_ref();
+        auto p = execute(a->live_left(), obj);
+        if( p->is_undef() ){
+            obj_unref(obj);
+            return(p);
+        }
+        early.push(p);
     }
 
-	/*
-	 * Here's the nasty one.  We have three or more, so recurse on our-
-	 *	selves to handle all but the first, then apply operation to
-	 *	first linked onto the result.  Normal business over undefined
-	 *	objects popping up.
-	 */
-    obj->cdr()->inc_ref();
-    assert(obj->cdr());
-    auto cdr = static_cast<live_obj_ptr>(obj->cdr());
-    p = do_rinsert(act, cdr);
-    if( p->is_undef() ){
-        obj_unref(obj);
-        return(p);
+    list_builder b;
+    for( ast_ptr a = act; a != stop; a = a->right ){
+        const bool last = (a->right == stop);
+        if( !last )
+            obj->inc_ref();
+        auto p = execute(a->live_left(), obj);
+        if( p->is_undef() ){
+            if( !last )
+                obj_unref(obj);
+            return(p);
+        }
+        b.push(p);
     }
-    auto result = obj_alloc(nullptr);
-    auto q = obj_alloc(obj->car(), result);
-    obj->car()->inc_ref();
-    q->cadr(p);
-    obj_unref(obj);
-    return( execute(act,q) );
+    if( stop ){
+        auto rest = early.finish();
+        for( list_iter it{rest}; !it.done(); it.next() ){
+            it.elem()->inc_ref();
+            b.push(it.elem());
+        }
+        obj_unref(rest);
+    }
+    return(b.finish());
 }
 
-/// Local function to handle the tedious binary inserting
-static live_obj_ptr
-do_binsert(live_ast_ptr act, live_obj_ptr obj)
+    /*
+     * Selection: k:x is the k'th element of list x, or with k negative,
+     *	the -k'th from the end.
+     */
+live_obj_ptr
+do_select(int x, live_obj_ptr obj)
 {
-    if( !obj->is_list() ){
+    if(
+        (!obj->is_list()) ||
+        obj->is_nil()
+    ){
         obj_unref(obj);
         return undefined();
     }
-
-	/*
-	 * If the list is empty, then we need to look at the applied
-	 *	operator.  If it's one for which we have an identity,
-	 *	return the identity.  Otherwise, undefined.  Bletch.
-	 */
-    if( !obj->car() ){
+    if( x == 0 ){
         obj_unref(obj);
-        live_obj_ptr result;
-        if( act->tag == 'c' ){
-            switch( act->val.YYint ){
-            case '+':
-            case '-':
-            result = obj_alloc(0);
-            break;
-            case '/':
-            case '*':
-            result = obj_alloc(1);
-            break;
-            default:
-            return undefined();
-            }
-        } else if ( act->tag == 'i' ){
-            switch( (act->val.YYsym)->sym_val.YYint ){
-            case AND:
-            result = obj_alloc(true);
-            break;
-            case OR:
-            case XOR:
-            result = obj_alloc(false);
-            break;
-            default:
-            return undefined();
-            }
-        } else return undefined();
-        return(result);
+        return undefined();
     }
 
-    // If the list has only one element, we return that element.
-    auto p = obj->cdr();
-    if( !p ){
-        p = obj->car();
-        assert(p);
-        p->inc_ref();
+        // Negative selectors count from end of list
+    if( x < 0 ){
+        const int tmp = obj->list_length();
+
+        x += (tmp+1);
+        if( x < 1 ){
         obj_unref(obj);
-        auto result = static_cast<live_obj_ptr>(p);
-        return(result);
+        return undefined();
+        }
     }
-
-	// If the list has two elements, we apply our operator and reduce
-    if( !p->cdr() ){
-        return( execute(act,obj) );
+    auto p = list_nth(obj, x-1);	// Referenced for us
+    obj_unref(obj);		// Unreference list as a whole
+    if( !p ){		// Fell off bottom of list
+        return undefined();
     }
+    auto result = static_cast<live_obj_ptr>(p);
+    return(result);
+}
 
-	/*
-	 * For three or more elements, we must set up to split the list
-	 *	into halves.  For every two steps which 'p' makes forward,
-	 *	'q' advances one.  When 'p' hits the end, 'q' names the 2nd
-	 *	half, and 'hd' names a copy of the first.
-	 */
-    obj_ptr q;
-    int x = 0;
-    obj_ptr hd = nullptr;
-    auto hdp = &hd;
-    for( q = obj; p; p = p->cdr() ){
-        if( x ){
-            auto r = obj_alloc(nullptr);
-            *hdp = r;
-            hdp = r->cdr_addr();
-            r->car(q->car());
-            q->car()->inc_ref();
-            q = q->cdr();
-            x = 0;
-        } else
-            x = 1;
+    /*
+     * Dropping: what k tl's in a row give, made by the rewriter.  x must
+     *	be a list of at least k elements.
+     */
+live_obj_ptr
+do_drop(int k, live_obj_ptr obj)
+{
+    if( !obj->is_list() || !obj->at_least(k) ){
+        obj_unref(obj);
+        return undefined();
     }
-    p = obj_alloc(q->car());
-    *hdp = p;
-    q->car()->inc_ref();
-
-	/*
-	 * 'q' names the second half, but we must add a reference, otherwise
-	 *	our use of it via execute() will consume it (and obj still
-	 *	references it...).
-	 */
-    q = q->cdr();
-    q->inc_ref();
-
-	/*
-	 * Almost there... "hd" is the first, "q" is the second, we encase
-	 *	them in an outer list, and call execute on them.
-	 */
-    auto new_list = obj_alloc(nullptr);
-    assert(hd);
-    auto live_hd = static_cast<live_obj_ptr>(hd);
-    p = obj_alloc(do_binsert(act,live_hd), new_list);
-    assert(q);
-    auto live_q = static_cast<live_obj_ptr>(q);
-    auto result = do_binsert(act,live_q);
-    p->cadr(result);
+    auto result = list_drop(obj, k);
     obj_unref(obj);
-    return(execute(act,p));
+    return(result);
+}
+
+    /*
+     * The value of an insert over an empty list.  If it's an operator
+     *	for which we have an identity, return the identity.  Otherwise,
+     *	undefined.  Bletch.
+     */
+live_obj_ptr
+insert_identity(live_ast_ptr act)
+{
+    if( act->tag == 'c' ){
+        switch( act->val.YYint ){
+        case '+':
+        case '-':
+            return obj_alloc(0);
+        case '/':
+        case '*':
+            return obj_alloc(1);
+        }
+    } else if ( act->tag == 'i' ){
+        switch( (act->val.YYsym)->sym_val.YYint ){
+        case AND:
+            return obj_alloc(true);
+        case OR:
+        case XOR:
+            return obj_alloc(false);
+        }
+    }
+    return undefined();
 }
@@ -2,5 +2,15 @@
 #define EXEC_H
 
 live_obj_ptr execute(live_ast_ptr act, live_obj_ptr obj);
+/// do_select()--the k:x selector function
+live_obj_ptr do_select(int x, live_obj_ptr obj);
+/// do_drop()--the k tl's in a row that the rewriter makes one 'D' node
+live_obj_ptr do_drop(int k, live_obj_ptr obj);
+/// insert_identity()--what !f or |f gives for <>, for AST f
+live_obj_ptr insert_identity(live_ast_ptr act);
+/// quick_form()--tell if an action surely finishes without running any user function
+bool quick_form(live_ast_ptr act);
+/// may_print()--tell if running act might print, through any user function it calls too
+bool may_print(ast_ptr act);
 
 #endif
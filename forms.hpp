@@ -0,0 +1,650 @@
+#ifndef FORMS_HPP
+#define FORMS_HPP
+
+#include <atomic>
+#include <vector>
+#include "yystype.h"
+#include "ast.hpp"
+#include "exec.h"
+#include "list.h"
+#include "math_intrinsics.h"
+#include "misc.h"
+#include "obj.h"
+#include "par.h"
+#include "object.hpp"
+#include "symtab_entry.hpp"
+#include "list_builder.hpp"
+#include "list_iter.hpp"
+#include "vector_ops.h"
+
+/**
+ * The functional forms which apply a function over and over: apply to
+ *	all, the two inserts and while.  The tree walker and the bytecode VM
+ *	both use these; each passes in how it applies the functions
+ *	involved, as a callable taking and returning a referenced object.
+ */
+
+    /*
+     * &f with the elements spread over par.cpp's threads.  Each result
+     *	goes in its element's slot, so they stay in order.  Once some
+     *	element gives ?, the answer is ?, so the later elements not yet
+     *	started are passed over.
+     */
+template <typename APPLY>
+live_obj_ptr
+form_par_map(live_obj_ptr obj, APPLY &apply)
+{
+    struct job {
+        live_obj_ptr range;
+        std::vector<obj_ptr> elems;
+        std::vector<obj_ptr> results;
+        std::atomic<unsigned> first_bad;
+        APPLY &apply;
+    };
+    const auto n = static_cast<unsigned>(obj->list_length());
+    job j{obj, {}, std::vector<obj_ptr>(n, nullptr), {n}, apply};
+    if( !obj->is_range() ){
+        j.range = nullptr;
+        j.elems.reserve(n);
+        for( list_iter it{obj}; !it.done(); it.next() )
+            j.elems.push_back(it.elem());
+    }
+
+    par_for(n, [](void *ctx, unsigned x){
+        auto &jb = *static_cast<job *>(ctx);
+        if( x > jb.first_bad.load(std::memory_order_relaxed) )
+            return;
+        live_obj_ptr p;
+        if( jb.range ){
+            p = obj_alloc(jb.range->range_elem(x));
+        } else {
+            p = static_cast<live_obj_ptr>(jb.elems[x]);
+            p->inc_ref();
+        }
+        auto q = jb.apply(p);
+        if( q->is_undef() ){
+            auto bad = jb.first_bad.load();
+            while( x < bad && !jb.first_bad.compare_exchange_weak(bad, x) )
+                ;
+        }
+        jb.results[x] = q;
+    }, &j);
+
+    obj_unref(obj);
+    if( j.first_bad.load() < n ){
+        for( auto q: j.results )
+            obj_unref(q);
+        return undefined();
+    }
+    list_builder b{n};
+    for( auto q: j.results )
+        b.push(static_cast<live_obj_ptr>(q));
+    return(b.finish());
+}
+
+    /*
+     * [f1, ..., fn]:obj with each function a task of its own; apply(x, o)
+     *	runs the x'th on o.  size is what par_fork() made of obj; it
+     *	only gives a size when none of them can print, since they run in
+     *	no order.  As with the members run one by one, any ? makes the
+     *	answer ?.
+     */
+template <typename APPLY>
+live_obj_ptr
+form_par_construct(live_ast_ptr cons, unsigned n, unsigned size, live_obj_ptr obj, APPLY apply)
+{
+    struct job {
+        live_obj_ptr obj;
+        std::vector<obj_ptr> results;
+        APPLY &apply;
+    };
+    job j{obj, std::vector<obj_ptr>(n, nullptr), apply};
+    par_join(cons, size, n, [](void *ctx, unsigned x){
+        auto &jb = *static_cast<job *>(ctx);
+        jb.obj->inc_ref();
+        jb.results[x] = jb.apply(x, jb.obj);
+    }, &j);
+
+    obj_unref(obj);
+    bool bad = false;
+    for( auto q: j.results )
+        bad = bad || q->is_undef();
+    if( bad ){
+        for( auto q: j.results )
+            obj_unref(q);
+        return undefined();
+    }
+    list_builder b{n};
+    for( auto q: j.results )
+        b.push(static_cast<live_obj_ptr>(q));
+    return(b.finish());
+}
+
+/// &f, where fn is f's AST and apply runs it
+template <typename APPLY>
+live_obj_ptr
+form_map(live_ast_ptr fn, live_obj_ptr obj, APPLY apply)
+{
+    if( !obj->is_list() ){
+        obj_unref(obj);
+        return undefined();
+    }
+    if( obj->is_nil() ) return(obj);
+    if( fn->tag == 'i' ){
+        auto tag = fn->val.YYsym->sym_val.YYint;
+        if( auto p = vec_math_func(tag, obj) )
+            return(static_cast<live_obj_ptr>(p));
+    }
+    const auto n = static_cast<unsigned>(obj->list_length());
+    if( par_wanted(fn, n) )
+        return form_par_map(obj, apply);
+    list_builder b{n};
+    for( list_iter it{obj}; !it.done(); it.next() ){
+        auto q = apply(it.take());
+        if( q->is_undef() ){
+            obj_unref(obj);
+            return(q);
+        }
+        b.push(q);
+    }
+    obj_unref(obj);
+    return(b.finish());
+}
+
+    /*
+     * The <x, acc> pairs !f hands f, one step after another.  f seldom
+     *	keeps its argument, so the pair is held on to, and if nothing
+     *	else holds it (or its second cell) once f is done, the same two
+     *	cells carry the next step's x and acc.  An intrinsic may update
+     *	a pair only it holds in place, so for one of those the pair is
+     *	left to it, and each step gets new cells.
+     */
+struct insert_pair final {
+    explicit insert_pair(live_ast_ptr fn)
+    : keep{fn->tag != 'i'}
+    {
+    }
+    ~insert_pair()
+    {
+        if( pair )
+            obj_unref(pair);
+    }
+    insert_pair(const insert_pair &) = delete;
+    insert_pair &operator=(const insert_pair &) = delete;
+
+    /// <x, acc>, referenced for the caller; takes both references
+    live_obj_ptr make(live_obj_ptr x, live_obj_ptr acc)
+    {
+        if( pair && pair->is_unique() && pair->cdr()->is_unique() ){
+            auto tail = pair->cdr();
+            auto old_x = pair->car();
+            auto old_acc = tail->car();
+            pair->car(x);
+            tail->car(acc);
+            pair->forget_hash();
+            tail->forget_hash();
+            obj_unref(old_x);
+            obj_unref(old_acc);
+            pair->inc_ref();
+            return static_cast<live_obj_ptr>(pair);
+        }
+        if( pair ){
+            obj_unref(pair);
+            pair = nullptr;
+        }
+        auto p = obj_alloc(x, obj_alloc(acc));
+        if( keep ){
+            p->inc_ref();
+            pair = p;
+        }
+        return(p);
+    }
+
+private:
+    const bool keep;
+    obj_ptr pair = nullptr;
+};
+
+/// !f, where fn is f's AST and apply runs it
+template <typename APPLY>
+live_obj_ptr
+form_rinsert(live_ast_ptr fn, live_obj_ptr obj, APPLY apply)
+{
+    if( !obj->is_list() ){
+        obj_unref(obj);
+        return undefined();
+    }
+
+	// Sums and products of unboxed numbers need no pair objects
+    if( auto p = vec_insert(fn, obj, false) )
+        return(static_cast<live_obj_ptr>(p));
+
+	// An empty list gives the operator's identity, if it has one
+    if( obj->is_nil() ){
+        obj_unref(obj);
+        return insert_identity(fn);
+    }
+
+	/*
+	 * A range's elements are made as they are wanted, from the end
+	 *	back, so iota's list is never written out.
+	 */
+    if( obj->is_range() ){
+        const auto n = obj->vec_length();
+        insert_pair args{fn};
+        auto p = obj_alloc(obj->range_elem(n - 1));
+        for( auto x = n - 1; x-- > 0; ){
+            p = apply(args.make(obj_alloc(obj->range_elem(x)), p));
+            if( p->is_undef() )
+                break;
+        }
+        obj_unref(obj);
+        return(p);
+    }
+
+	// If the list has only one element, we return that element.
+    if( !obj->at_least(2) ){
+        auto p = obj->car();
+        p->inc_ref();
+        obj_unref(obj);
+        return(p);
+    }
+
+	// If the list has two elements, we apply our operator and reduce
+    if( !obj->at_least(3) ){
+        return( apply(obj) );
+    }
+
+	/*
+	 * Three or more: work back from the end, applying the operator to
+	 *	each element paired with the result so far.  The elements wait
+	 *	on the heap rather than in a recursion, however long the list.
+	 */
+    std::vector<live_obj_ptr> elems;
+    elems.reserve(static_cast<size_t>(obj->list_length()));
+    for( list_iter it{obj}; !it.done(); it.next() )
+        elems.push_back(it.elem());
+    insert_pair args{fn};
+    auto p = elems.back();
+    p->inc_ref();
+    for( auto x = elems.size() - 1; x-- > 0; ){
+        elems[x]->inc_ref();
+        p = apply(args.make(elems[x], p));
+        if( p->is_undef() )
+            break;
+    }
+    obj_unref(obj);
+    return(p);
+}
+
+/// |f, where form is its AST and apply runs f
+template <typename APPLY>
+live_obj_ptr
+form_binsert(live_ast_ptr form, live_obj_ptr obj, APPLY apply)
+{
+    auto fn = form->live_left();
+    if( !obj->is_list() ){
+        obj_unref(obj);
+        return undefined();
+    }
+
+	// Sums and products of unboxed numbers need no pair objects
+    if( auto p = vec_insert(fn, obj, true) )
+        return(static_cast<live_obj_ptr>(p));
+
+	// An empty list gives the operator's identity, if it has one
+    if( obj->is_nil() ){
+        obj_unref(obj);
+        return insert_identity(fn);
+    }
+
+	// Ranges short enough to fall through to here are made as needed
+    if( obj->is_range() && !obj->at_least(3) ){
+        const auto n = obj->vec_length();
+        auto p = obj_alloc(obj->range_elem(0));
+        if( n > 1 )
+            p = apply(obj_alloc(p, obj_alloc(obj_alloc(obj->range_elem(1)))));
+        obj_unref(obj);
+        return(p);
+    }
+
+    // If the list has only one element, we return that element.
+    if( !obj->at_least(2) ){
+        auto p = obj->car();
+        assert(p);
+        p->inc_ref();
+        obj_unref(obj);
+        auto result = static_cast<live_obj_ptr>(p);
+        return(result);
+    }
+
+	// If the list has two elements, we apply our operator and reduce
+    if( !obj->at_least(3) ){
+        return( apply(obj) );
+    }
+
+	/*
+	 * For three or more elements, we must set up to split the list
+	 *	into halves.  The first half gets the odd element.  A long
+	 *	chain of cons cells is laid out in a store once, here at the
+	 *	top, so that both halves, and theirs in turn, are views of it
+	 *	rather than copies.
+	 */
+    if( !obj->is_vector() && obj->at_least(list_builder::VECTOR_MIN) )
+        obj = list_vector(obj);
+    const int half = (obj->list_length() + 1) / 2;
+    auto live_hd = list_take(obj, half);
+    auto live_q = list_drop(obj, half);
+
+	/*
+	 * Almost there... "hd" is the first, "q" is the second, we encase
+	 *	them in an outer list, and apply the operator to them.  Big
+	 *	enough halves are reduced as two tasks.
+	 */
+    obj_ptr halves[2] = {live_hd, live_q};
+    if( auto size = par_fork(form, obj) ){
+        struct job {
+            live_ast_ptr form;
+            obj_ptr *halves;
+            APPLY &apply;
+        };
+        job j{form, halves, apply};
+        par_join(form, size, 2, [](void *ctx, unsigned x){
+            auto &jb = *static_cast<job *>(ctx);
+            jb.halves[x] = form_binsert(jb.form, static_cast<live_obj_ptr>(jb.halves[x]), jb.apply);
+        }, &j);
+    } else {
+        halves[0] = form_binsert(form, live_hd, apply);
+        halves[1] = form_binsert(form, live_q, apply);
+    }
+    auto first = static_cast<live_obj_ptr>(halves[0]);
+    auto second = static_cast<live_obj_ptr>(halves[1]);
+    auto p = obj_alloc(first, obj_alloc(second));
+    obj_unref(obj);
+    return( apply(p) );
+}
+
+/// (while p f), with test applying p and body applying f
+template <typename TEST, typename BODY>
+live_obj_ptr
+form_while(live_obj_ptr obj, TEST test, BODY body)
+{
+    while( 1 ){
+        if( obj->is_undef() ){
+            break;
+        }
+        obj->inc_ref();
+        auto p = test(obj);
+        if( !p->is_bool() ){
+            obj_unref(p);
+            break;
+        }
+        if( p->bool_val() ){
+            obj_unref(p);
+            obj = body(obj);
+        } else {
+            obj_unref(p);
+            return(obj);
+        }
+    }
+    obj_unref(obj);
+    return undefined();
+}
+
+/// Where a pipeline ('P') gets the elements it streams; kept in its val
+enum class pipe_from : int {
+    /// The elements of the argument
+    ELEMS,
+    /// 1..n, for a source of iota
+    COUNT,
+    /// <x, y> for each y, for distl over <x, <ys>>
+    DIST_LEFT,
+    /// <y, x> for each y, for distr over <<ys>, x>
+    DIST_RIGHT
+};
+
+/// What comes out of a pipeline's last stage: counted, or collected
+struct pipe_out final {
+    list_builder b;
+    bool counting = false;
+    int count = 0;
+
+    void push(live_obj_ptr p)
+    {
+        if( counting ){
+            ++count;
+            obj_unref(p);
+        } else {
+            b.push(p);
+        }
+    }
+};
+
+    /*
+     * Send x down the stages of a pipeline from stage on.  'm' maps with
+     *	its left; 'k' keeps x if its left says T, passing on middle:x
+     *	(x if there's no middle); 'K' is the same but middle:x is a list
+     *	whose elements all go on; 'f' passes on the elements of left:x.
+     *	Gives false, having dropped everything, if any of it gives ?.
+     */
+template <typename APPLY>
+bool
+pipe_push(ast_ptr stage, live_obj_ptr x, pipe_out &out, APPLY &apply)
+{
+    if( !stage ){
+        out.push(x);
+        return(true);
+    }
+    obj_ptr q = nullptr;
+    switch( stage->tag ){
+    case 'm':
+        q = apply(stage->live_left(), x);
+        break;
+    case 'k':
+    case 'K': {
+        x->inc_ref();
+        auto t = apply(stage->live_left(), x);
+        const bool ok = t->is_bool();
+        const bool keep = ok && t->bool_val();
+        obj_unref(t);
+        if( !keep ){
+            obj_unref(x);
+            return(ok);
+        }
+        if( !stage->middle ){
+            q = x;
+            break;
+        }
+        q = apply(stage->live_middle(), x);
+        break;
+    }
+    case 'f':
+        q = apply(stage->live_left(), x);
+        break;
+    default:
+        fatal_err("Bad pipeline stage");
+    }
+    auto live_q = static_cast<live_obj_ptr>(q);
+    if( stage->tag == 'm' || stage->tag == 'k' ){
+        if( live_q->is_undef() ){
+            obj_unref(live_q);
+            return(false);
+        }
+        return pipe_push(stage->right, live_q, out, apply);
+    }
+
+	// A flat stage's result must be a list, each element of which goes on
+    if( !live_q->is_list() ){
+        obj_unref(live_q);
+        return(false);
+    }
+    for( list_iter it{live_q}; !it.done(); it.next() ){
+        it.elem()->inc_ref();
+        if( !pipe_push(stage->right, it.elem(), out, apply) ){
+            obj_unref(live_q);
+            return(false);
+        }
+    }
+    obj_unref(live_q);
+    return(true);
+}
+
+    /*
+     * The elements a pipeline's source makes from obj, as a list, if its
+     *	stages are all maps and are worth spreading over the threads; so
+     *	each element gives one result, and form_par_map() can do them.
+     *	Otherwise null, leaving obj alone.
+     */
+inline obj_ptr
+pipe_par_source(live_ast_ptr pipe, live_obj_ptr obj)
+{
+    for( auto stage = pipe->left; stage; stage = stage->right ){
+        if( stage->tag != 'm' )
+            return(nullptr);
+    }
+    const auto from = static_cast<pipe_from>(pipe->val.YYint);
+    const bool left = from == pipe_from::DIST_LEFT;
+    unsigned n = 0;
+    switch( from ){
+    case pipe_from::ELEMS:
+        if( !obj->is_list() )
+            return(nullptr);
+        n = static_cast<unsigned>(obj->list_length());
+        break;
+    case pipe_from::COUNT:
+        if( !obj->is_int() || obj->int_val() < 0 )
+            return(nullptr);
+        n = static_cast<unsigned>(obj->int_val());
+        break;
+    case pipe_from::DIST_LEFT:
+    case pipe_from::DIST_RIGHT:
+        if( !obj->is_list() || !obj->car() || !obj->at_least(2) ||
+            !(left ? obj->cadr() : obj->car())->is_list() )
+            return(nullptr);
+        n = static_cast<unsigned>((left ? obj->cadr() : obj->car())->list_length());
+        break;
+    }
+    if( !par_wanted(pipe->live_left(), n) )
+        return(nullptr);
+    if( from == pipe_from::ELEMS )
+        return(obj);
+
+    list_builder b{n};
+    switch( from ){
+    case pipe_from::ELEMS:
+        break;
+    case pipe_from::COUNT:
+        for( unsigned x = 1; x <= n; ++x )
+            b.push(static_cast<int>(x));
+        break;
+    case pipe_from::DIST_LEFT:
+    case pipe_from::DIST_RIGHT: {
+        auto elem = static_cast<live_obj_ptr>(left ? obj->car() : obj->cadr());
+        auto lst = static_cast<live_obj_ptr>(left ? obj->cadr() : obj->car());
+        for( list_iter it{lst}; !it.done(); it.next() ){
+            auto item = it.take();
+            elem->inc_ref();
+            b.push(left ? obj_alloc(elem, obj_alloc(item)) : obj_alloc(item, obj_alloc(elem)));
+        }
+        break;
+    }
+    }
+    obj_unref(obj);
+    return(b.finish());
+}
+
+/// Hand what came out of a pipeline's stages, a list or ?, to its sink
+template <typename APPLY>
+live_obj_ptr
+pipe_sink(live_ast_ptr pipe, live_obj_ptr lst, APPLY &apply)
+{
+    auto sink = pipe->right;
+    if( !sink || lst->is_undef() )
+        return(lst);
+    if( sink->tag == 'i' ){
+        auto count = obj_alloc(static_cast<int>(lst->list_length()));
+        obj_unref(lst);
+        return(count);
+    }
+    auto fn = sink->live_left();
+    auto apply_fn = [&apply, fn](live_obj_ptr x){ return apply(fn, x); };
+    if( sink->tag == '!' )
+        return form_rinsert(fn, lst, apply_fn);
+    return form_binsert(static_cast<live_ast_ptr>(sink), lst, apply_fn);
+}
+
+    /*
+     * A pipeline: the source in the node's val makes elements from obj,
+     *	one at a time; each goes down the stages in left; what comes out
+     *	goes to the sink in right.  That's !f or |f, which get the
+     *	collected results; length, which counts them; or nothing, in which
+     *	case they're the result.  apply takes a function's AST and an
+     *	object; no list is built between the stages, only at the end.
+     */
+template <typename APPLY>
+live_obj_ptr
+form_pipeline(live_ast_ptr pipe, live_obj_ptr obj, APPLY apply)
+{
+    if( auto src = pipe_par_source(pipe, obj) ){
+        auto stages = pipe->left;
+        auto each = [&apply, stages](live_obj_ptr x){
+            for( auto stage = stages; stage && !x->is_undef(); stage = stage->right )
+                x = apply(stage->live_left(), x);
+            return x;
+        };
+        return pipe_sink(pipe, form_par_map(static_cast<live_obj_ptr>(src), each), apply);
+    }
+
+    const auto from = static_cast<pipe_from>(pipe->val.YYint);
+    auto sink = pipe->right;
+    pipe_out out;
+    out.counting = sink && sink->tag == 'i';
+    bool ok = true;
+    switch( from ){
+    case pipe_from::ELEMS:
+        if( !obj->is_list() ){
+            ok = false;
+            break;
+        }
+        for( list_iter it{obj}; ok && !it.done(); it.next() )
+            ok = pipe_push(pipe->left, it.take(), out, apply);
+        break;
+    case pipe_from::COUNT: {
+        if( !obj->is_num() ){
+            ok = false;
+            break;
+        }
+        const int n = obj->is_int() ? obj->int_val() : static_cast<int>(obj->float_val());
+        ok = n >= 0;
+        for( int x = 1; ok && x <= n; ++x )
+            ok = pipe_push(pipe->left, obj_alloc(x), out, apply);
+        break;
+    }
+    case pipe_from::DIST_LEFT:
+    case pipe_from::DIST_RIGHT: {
+        const bool left = from == pipe_from::DIST_LEFT;
+        if( !obj->is_list() || !obj->car() || !obj->at_least(2) ||
+            !(left ? obj->cadr() : obj->car())->is_list() ){
+            ok = false;
+            break;
+        }
+        auto elem = static_cast<live_obj_ptr>(left ? obj->car() : obj->cadr());
+        auto lst = static_cast<live_obj_ptr>(left ? obj->cadr() : obj->car());
+        for( list_iter it{lst}; ok && !it.done(); it.next() ){
+            auto item = it.take();
+            elem->inc_ref();
+            auto pair = left ? obj_alloc(elem, obj_alloc(item)) : obj_alloc(item, obj_alloc(elem));
+            ok = pipe_push(pipe->left, pair, out, apply);
+        }
+        break;
+    }
+    }
+    obj_unref(obj);
+    if( !ok )
+        return undefined();
+    if( out.counting )
+        return obj_alloc(out.count);
+    return pipe_sink(pipe, out.b.finish(), apply);
+}
+
+#endif
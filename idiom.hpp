@@ -0,0 +1,20 @@
+#ifndef IDIOM_HPP
+#define IDIOM_HPP
+
+/// Which kernel a 'V' node runs; kept in its val
+enum class idiom : int {
+    /// !+@&*@trans: the inner product of <a, b>
+    DOT,
+    /// |+@&*@trans: the same, summed in |'s order
+    DOT_BINARY,
+    /// &DOT@distl: <v, m> to v times each row of m
+    DOT_ROWS_LEFT,
+    /// &DOT@distr: <m, v> to each row of m times v
+    DOT_ROWS_RIGHT,
+    /// !(&+@trans)@&(&*@distl)@trans: <v, m> to the vector v times the matrix m
+    VEC_MAT,
+    /// &(&DOT@distl)@distr@[1, trans@2]: <a, b> to the matrix a times the matrix b
+    MAT_MUL
+};
+
+#endif
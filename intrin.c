@@ -2,17 +2,29 @@
  * intrin.c--intrinsic functions for FP.  These are the ones which
  *	parse as an identifier, and are symbol-tabled.
  *
+ *	Each has a handler of its own, kept with its symbol table entry
+ *	and copied into the 'i' nodes that call it, so running one is a
+ *	call through a pointer.  intrin_register() adds more; the grammar
+ *	need not know them, since a builtin without a token of its own
+ *	lexes as INTRINSIC.
+ *
  * 	Copyright (c) 1986 by Andy Valencia
  */
 #include <math.h>
 #include <stdio.h>
+#include <vector>
 #include "fpcommon.h"
 #include "intrin.h"
 #include "math_intrinsics.h"
 #include "misc.h"
+#include "symtab.h"
 #include "charfn.h"
+#include "list.h"
 #include "obj.h"
+#include "vector_ops.h"
 #include "object.hpp"
+#include "list_builder.hpp"
+#include "list_iter.hpp"
 #include "yystype.h"
 #include "symtab_entry.hpp"
 #include "y.tab.h"
@@ -28,38 +40,26 @@ static live_obj_ptr do_pair(live_obj_ptr obj)
 {
     if(
        (!obj->is_list()) ||
-       !obj->car()
+       obj->is_nil()
        ){
         obj_unref(obj);
         return undefined();
     }
-    obj_ptr hd = nullptr;
-    obj_ptr *hdp = &hd;
-    obj_ptr q;
-    obj_ptr r = nullptr;
-    obj_ptr p = obj;
-    for(int x = 0; p; p = p->cdr() ){
-        if( x == 0 ){
-            q = obj_alloc(nullptr);
-            *hdp = q;
-            hdp = q->cdr_addr();
-            r = obj_alloc(nullptr);
-            q->car(r);
-            r->car(p->car());
-            p->car()->inc_ref();
-            x++;
-        } else {
-            q = obj_alloc(nullptr);
-            r->cdr(q);
-            q->car(p->car());
-            p->car()->inc_ref();
-            x = 0;
+    list_builder b;
+    for( list_iter it{obj}; !it.done(); ){
+        auto p = it.elem();
+        p->inc_ref();
+        it.next();
+        obj_ptr q = nullptr;
+        if( !it.done() ){
+            q = obj_alloc(it.elem());
+            it.elem()->inc_ref();
+            it.next();
         }
+        b.push(obj_alloc(p, q));
     }
     obj_unref(obj);
-    assert(hd);
-    auto live_hd = static_cast<live_obj_ptr>(hd);
-    return(live_hd);
+    return(b.finish());
 }
 
 /// Split list into two (roughly) equal halves
@@ -73,33 +73,10 @@ static live_obj_ptr do_split(live_obj_ptr obj)
         obj_unref(obj);
         return undefined();
     }
-    obj_ptr hd = nullptr;
-    obj_ptr *hdp = &hd;
     l = ((l-1) >> 1)+1;
-    int x;
-    auto p = obj;
-    for( x = 0; x < l; ++x, p = p->cdr() ){
-        auto q = obj_alloc(nullptr);
-        *hdp = q;
-        hdp = q->cdr_addr();
-        q->car(p->car());
-        p->car()->inc_ref();
-    }
-    auto top = obj_alloc(hd);
-    hd = nullptr;
-    hdp = &hd;
-    while(p){
-        auto q = obj_alloc(nullptr);
-        *hdp = q;
-        hdp = q->cdr_addr();
-        q->car(p->car());
-        p->car()->inc_ref();
-        p = p->cdr();
-    }
-    if( !hd ) hd = obj_alloc(nullptr);
-    auto result = obj_alloc(nullptr);
-    top->cdr(result);
-    top->cadr(hd);
+    auto first = list_take(obj, l);
+    auto second = list_drop(obj, l);
+    auto top = obj_alloc(first, obj_alloc(second));
     obj_unref(obj);
     return(top);
 }
@@ -117,6 +94,7 @@ static live_obj_ptr do_atom(live_obj_ptr obj)
             result = true;
             break;
         case obj_type::T_LIST:
+        case obj_type::T_VECTOR:
             result = false;
     }
     auto p = obj_alloc(result);
@@ -124,546 +102,517 @@ static live_obj_ptr do_atom(live_obj_ptr obj)
     return(p);
 }
 
-/// Main intrinsic processing routine
-live_obj_ptr
-do_intrinsics(live_sym_ptr act, live_obj_ptr obj)
+/// Length of a list
+static live_obj_ptr
+do_length(live_obj_ptr obj)
 {
-    assert(act);
-
-	/*
-	 * Switch off the tokenal value assigned by YACC.  Depending on the
-	 *	sophistication of your C compiler, this can generate some
-	 *	truly horrendous code.  Be prepared!  Perhaps it would be
-	 *	better to store a pointer to a function in with the symbol
-	 *	table...
-	 */
-    const int tag = act->sym_val.YYint;
-    switch( tag ){
-
-    case LENGTH:{	// Length of a list
-        if( !obj->is_list() ){
-            obj_unref(obj);
-            return undefined();
-        }
-        int l = 0;
-        for(obj_ptr p = obj; p && p->car(); p = p->cdr() ) l++;
+    if( !obj->is_list() ){
         obj_unref(obj);
-        auto p = obj_alloc(l);
-        return(p);
+        return undefined();
     }
+    const int l = obj->list_length();
+    obj_unref(obj);
+    auto p = obj_alloc(l);
+    return(p);
+}
 
-    case ID: {		// Identity
-            return(obj);
+/// Identity
+static live_obj_ptr
+do_id(live_obj_ptr obj)
+{
+    return(obj);
+}
+
+/// Identity, but print debug line too
+static live_obj_ptr
+do_out(live_obj_ptr obj)
+{
+    printf("out: ");
+    obj_prtree(obj);
+    putchar('\n');
+    return(obj);
+}
+
+/// First elem of a list
+static live_obj_ptr
+do_hd(live_obj_ptr obj)
+{
+    if( !obj->is_list() ){
+        obj_unref(obj);
+        return undefined();
     }
-    case OUT: {		// Identity, but print debug line too
-        printf("out: ");
-        obj_prtree(obj);
-        putchar('\n');
-        return(obj);
+    if (obj->is_nil()) {
+        return obj;
     }
-    
-    case FIRST:
-    case HD: {		// First elem of a list
-        if( !obj->is_list() ){
-            obj_unref(obj);
-            return undefined();
-        }
-        if (!obj->car()) {
-            return obj;
-        }
-        assert(obj->car());
-        auto p = static_cast<live_obj_ptr>(obj->car());
-        p->inc_ref();
+    assert(obj->car());
+    auto p = static_cast<live_obj_ptr>(obj->car());
+    p->inc_ref();
+    obj_unref(obj);
+    return(p);
+}
+
+/// Remainder of list
+static live_obj_ptr
+do_tl(live_obj_ptr obj)
+{
+    if( (!obj->is_list()) || obj->is_nil() ){
         obj_unref(obj);
-        return(p);
+        return undefined();
     }
+    auto result = list_drop(obj, 1);
+    obj_unref(obj);
+    return(result);
+}
 
-    case TL: {		// Remainder of list
-        if( (!obj->is_list()) || !obj->car() ){
-            obj_unref(obj);
-            return undefined();
-        }
-        auto p = obj->cdr();
-        if(!p){
-            p = obj_alloc(nullptr);
-        } else {
-            p->inc_ref();
-        }
+/// Given arg N, generate <1..N>
+static live_obj_ptr
+do_iota(live_obj_ptr obj)
+{
+    if( !obj->is_num() ){
         obj_unref(obj);
-        assert(p);
-        auto result = static_cast<live_obj_ptr>(p);
-        return(result);
+        return undefined();
     }
+    int l = (obj->is_int()) ? obj->int_val() : static_cast<int>(obj->float_val());
+    obj_unref(obj);
+    if( l < 0 ) return undefined();
 
-    case IOTA:{		// Given arg N, generate <1..N>
-        if( !obj->is_num() ){
-            obj_unref(obj);
-            return undefined();
-        }
-        int l = (obj->is_int()) ? obj->int_val() : static_cast<int>(obj->float_val());
+	// A long one is a range, written out only if something must read it
+    const auto n = static_cast<unsigned>(l);
+    if( n >= list_builder::VECTOR_MIN ){
+        return obj_alloc(vector_store::create_range(n), 0, n);
+    }
+    list_builder b{n};
+    for(int x = 1; x <= l; x++ ){
+        b.push(x);
+    }
+    return(b.finish());
+}
+
+/// Parameterized selection
+static live_obj_ptr
+do_pick(live_obj_ptr obj)
+{
+    obj_ptr p;
+    obj_ptr q;
+    int x;
+
+        // Verify all elements which we will use
+    if(
+        (!obj->is_list()) ||
+        !obj->at_least(2) ||
+        ( (p = obj->car())->type() != obj_type::T_INT ) ||
+        ( !(q = obj->cadr())->is_list() ) ||
+        ( (x = p->int_val()) == 0 )
+    ){
         obj_unref(obj);
-        if( l < 0 ) return undefined();
-        if( l == 0 ) return( obj_alloc(nullptr) );
-        obj_ptr hd;
-        obj_ptr *hdp = &hd;
-        for(int x = 1; x <= l; x++ ){
-            auto q = obj_alloc(x);
-            auto p = obj_alloc(nullptr);
-            *hdp = p;
-            p->car(q);
-            hdp = p->cdr_addr();
-        }
-        assert(hd);
-        auto result = static_cast<live_obj_ptr>(hd);
-        return(result);
-    } // Local block for IOTA
-
-    case PICK:{		// Parameterized selection
-        int x;
-        obj_ptr p;
-        obj_ptr q;
-
-            // Verify all elements which we will use
-        if(
-            (!obj->is_list()) ||
-            ( (p = obj->car())->type() != obj_type::T_INT ) ||
-            !(q = obj->cdr()) ||
-            ( (q = q->car())->type() != obj_type::T_LIST) ||
-            ( (x = p->int_val()) == 0 )
-        ){
+        return undefined();
+    }
+    assert(q);
+    auto lst = static_cast<live_obj_ptr>(q);
+
+        // If x is negative, we are counting from the end
+    if( x < 0 ){
+        x += (lst->list_length() + 1);
+        if( x < 1 ){
             obj_unref(obj);
             return undefined();
         }
+    }
 
-            // If x is negative, we are counting from the end
-        if( x < 0 ){
-            const int tmp = q->list_length();
+        // If fell off the list, error
+    auto result = list_nth(lst, x-1);
+    obj_unref(obj);
+    if( !result )
+        return undefined();
+    return(static_cast<live_obj_ptr>(result));
+}
 
-            x += (tmp + 1);
-            if( x < 1 ){
-                obj_unref(obj);
-                return undefined();
-            }
-        }
+/// Return last element of list
+static live_obj_ptr
+do_last(live_obj_ptr obj)
+{
+    if( !obj->is_list() ){
+        obj_unref(obj);
+        return undefined();
+    }
+    if( obj->is_nil() )
+        return(obj);
+    auto q = list_nth(obj, obj->list_length()-1);
+    obj_unref(obj);
+    assert(q);
+    auto result = static_cast<live_obj_ptr>(q);
+    return(result);
+}
 
-            // Loop along the list until our count is expired
-        for( ; x > 1; --x ){
-            if( !q )
-                break;
-            q = q->cdr();
-        }
+/// Return a list of all but the last element
+static live_obj_ptr
+do_tlr(live_obj_ptr obj)
+{
+    if(
+        (!obj->is_list()) ||
+        obj->is_nil()
+    ){
+        obj_unref(obj);
+        return undefined();
+    }
+    if( list_unique(obj) ){
+        auto result = list_drop_last_unique(obj);
+        if( result )
+            return static_cast<live_obj_ptr>(result);
+    }
+    auto result = list_take(obj, obj->list_length()-1);
+    obj_unref(obj);
+    return(result);
+}
 
-            // If fell off the list, error
-        if( !q || !(q = q->car()) ){
-            obj_unref(obj);
-            return undefined();
-        }
+/// Distribute from left-most element
+static live_obj_ptr
+do_distl(live_obj_ptr obj)
+{
+    obj_ptr p;
+    obj_ptr q;
+    if(
+        (!obj->is_list()) ||
+        ( !(q = obj->car()) ) ||
+        (!obj->at_least(2)) ||
+        (!(p = obj->cadr()) ) ||
+        (!p->is_list())
+    ){
+        obj_unref(obj);
+        return undefined();
+    }
+    assert(p);
+    auto live_p = static_cast<live_obj_ptr>(p);
+    assert(q);
+    auto live_q = static_cast<live_obj_ptr>(q);
+    return( do_dist(live_q,live_p,obj,0) );
+}
 
-            // Add a reference to the named object, release the old object
-        q->inc_ref();
+/// Distribute from right-most element
+static live_obj_ptr
+do_distr(live_obj_ptr obj)
+{
+    obj_ptr p;
+    obj_ptr q;
+    if(
+        (!obj->is_list()) ||
+        ( !(q = obj->car()) ) ||
+        (!obj->at_least(2)) ||
+        (!(p = obj->cadr()) ) ||
+        (!q->is_list())
+    ){
         obj_unref(obj);
-        assert(q);
-        auto result = static_cast<live_obj_ptr>(q);
-        return(result);
+        return undefined();
     }
+    assert(p);
+    auto live_p = static_cast<live_obj_ptr>(p);
+    assert(q);
+    auto live_q = static_cast<live_obj_ptr>(q);
+    return( do_dist(live_p,live_q,obj,1) );
+}
 
-    case LAST: {		// Return last element of list
-        if( !obj->is_list() ){
-            obj_unref(obj);
-            return undefined();
-        }
-        if( !obj->car() )
-            return(obj);
-        obj_ptr p;
-        obj_ptr q = obj;
-        while( (p = q->cdr()) )
-            q = p;
-        q = q->car();
-        q->inc_ref();
+/// Append element from left
+static live_obj_ptr
+do_apndl(live_obj_ptr obj)
+{
+    obj_ptr p;
+    obj_ptr q;
+
+    if(
+        (!obj->is_list()) ||
+        ( !(q = obj->car()) ) ||
+        (!obj->at_least(2)) ||
+        (!(p = obj->cadr()) ) ||
+        (!p->is_list())
+    ){
         obj_unref(obj);
-        assert(q);
-        auto result = static_cast<live_obj_ptr>(q);
-        return(result);
+        return undefined();
     }
-    
-    case FRONT:
-    case TLR:{		// Return a list of all but list
-        obj_ptr q = obj;
-        if(
-            (!q->is_list()) ||
-            !obj->car()
-        ){
-            obj_unref(obj);
-            return undefined();
-        }
-        obj_ptr hd = nullptr;
-        obj_ptr *hdp = &hd;
-        while( q->cdr() ){
-            auto p = obj_alloc(q->car());
-            *hdp = p;
-            if( p->car() ){
-                p->car()->inc_ref();
-            }
-            hdp = p->cdr_addr();
-            q = q->cdr();
-        }
+    q->inc_ref();
+    if( p->is_nil() ){		// Null list?
         obj_unref(obj);
-        if( !hd )
-            return( obj_alloc(nullptr) );
-        else {
-            assert(hd);
-            auto result = static_cast<live_obj_ptr>(hd);
-            return(result);
-        }
+        auto result = obj_alloc(q);
+        return(result);		// Just return element
     }
+    p->inc_ref();
+    auto result = obj_alloc(q, p);
+    obj_unref(obj);
+    return(result);
+}
 
-    case DISTL: {		// Distribute from left-most element
-        obj_ptr p;
-        obj_ptr q;
-        if(
-            (!obj->is_list()) ||
-            ( !(q = obj->car()) ) ||
-            (!obj->cdr()) ||
-            (!(p = obj->cadr()) ) ||
-            (!p->is_list())
-        ){
-            obj_unref(obj);
-            return undefined();
-        }
-        assert(p);
-        auto live_p = static_cast<live_obj_ptr>(p);
-        assert(q);
-        auto live_q = static_cast<live_obj_ptr>(q);
-        return( do_dist(live_q,live_p,obj,0) );
-    }
-
-    case DISTR:	{	// Distribute from left-most element
-        obj_ptr p;
-        obj_ptr q;
-        if(
-            (!obj->is_list()) ||
-            ( !(q = obj->car()) ) ||
-            (!obj->cdr()) ||
-            (!(p = obj->cadr()) ) ||
-            (!q->is_list())
-        ){
-            obj_unref(obj);
-            return undefined();
-        }
-        assert(p);
-        auto live_p = static_cast<live_obj_ptr>(p);
-        assert(q);
-        auto live_q = static_cast<live_obj_ptr>(q);
-        return( do_dist(live_p,live_q,obj,1) );
+/// Append element from right
+static live_obj_ptr
+do_apndr(live_obj_ptr obj)
+{
+    obj_ptr q;
+    obj_ptr r;
+
+    if(
+        (!obj->is_list()) ||
+        ( !(q = obj->car()) ) ||
+        (!obj->at_least(2)) ||
+        (!(r = obj->cadr()) ) ||
+        (!q->is_list())
+    ){
+        obj_unref(obj);
+        return undefined();
     }
-    
-    case APNDL:{	// Append element from left
-        obj_ptr p;
-        obj_ptr q;
-
-        if(
-            (!obj->is_list()) ||
-            ( !(q = obj->car()) ) ||
-            (!obj->cdr()) ||
-            (!(p = obj->cadr()) ) ||
-            (!p->is_list())
-        ){
-            obj_unref(obj);
-            return undefined();
-        }
-        q->inc_ref();
-        if( !p->car() ){		// Null list?
-            obj_unref(obj);
-            auto result = obj_alloc(q);
-            return(result);		// Just return element
-        }
-        p->inc_ref();
-        auto result = obj_alloc(q, p);
+    r->inc_ref();
+    if( q->is_nil() ){		// Empty list
         obj_unref(obj);
-        return(result);
-    }
-
-    case APNDR:{	// Append element from right
-        obj_ptr hd = nullptr;
-        obj_ptr *hdp = &hd;
-        obj_ptr q;
-        obj_ptr r;
-
-        if(
-            (!obj->is_list()) ||
-            ( !(q = obj->car()) ) ||
-            (!obj->cdr()) ||
-            (!(r = obj->cadr()) ) ||
-            (!q->is_list())
-        ){
-            obj_unref(obj);
-            return undefined();
-        }
-        r->inc_ref();
-        if( !q->car() ){		// Empty list
+        auto result = obj_alloc(r);
+        return(result);		// Just return elem
+    }
+
+        // Nobody else sees q?  Then just add to its end.
+    if( list_unique(obj) && list_unique(q) ){
+        auto result = list_append_unique(q, r);
+        if( result ){
+            q->inc_ref();
             obj_unref(obj);
-            auto result = obj_alloc(r);
-            return(result);		// Just return elem
+            return static_cast<live_obj_ptr>(result);
         }
+    }
 
-            /*
-             * Loop through list, building a new one.  We can't just reuse
-             *	the old one because we're modifying its end.
-             */
-        while( q ){
-            auto p = obj_alloc(nullptr);
-            *hdp = p;
-            q->car()->inc_ref();
-            p->car(q->car());
-            hdp = p->cdr_addr();
-            q = q->cdr();
-        }
+        /*
+         * Loop through list, building a new one.  We can't just reuse
+         *	the old one because we're modifying its end.
+         */
+    list_builder b{static_cast<unsigned>(q->list_length()) + 1};
+    for( list_iter it{q}; !it.done(); it.next() ){
+        it.elem()->inc_ref();
+        b.push(it.elem());
+    }
 
-            // Tack the element onto the end of the built list
-        auto p = obj_alloc(r);
-        *hdp = p;
+        // Tack the element onto the end of the built list
+    assert(r);
+    b.push(static_cast<live_obj_ptr>(r));
+    obj_unref(obj);
+    return(b.finish());
+}
+
+/// Reverse all elements of a list
+static live_obj_ptr
+do_reverse(live_obj_ptr obj)
+{
+    if( !obj->is_list() ){
         obj_unref(obj);
-        assert(hd);
-        auto result = static_cast<live_obj_ptr>(hd);
-        return(result);
+        return undefined();
     }
-
-    case TRANS:	{	// Transposition
-        return( do_trans(obj) );
+    if( obj->is_nil() )
+        return(obj);
+    if( list_unique(obj) ){
+        auto result = list_reverse_unique(obj);
+        if( result )
+            return static_cast<live_obj_ptr>(result);
     }
-    
-    case REVERSE:{	// Reverse all elements of a list
+    list_builder b{static_cast<unsigned>(obj->list_length())};
+    for( list_iter it{obj}; !it.done(); it.next() ){
+        it.elem()->inc_ref();
+        b.push(it.elem());
+    }
+    b.reverse();
+    obj_unref(obj);
+    return(b.finish());
+}
 
-        if( !obj->is_list() ){
-            obj_unref(obj);
-            return undefined();
-        }
-        obj_ptr p;
-        obj_ptr q;
-        if( !obj->car() )
-            return(obj);
-        for( p = nullptr, q = obj; q; q = q->cdr() ){
-            auto r = obj_alloc(nullptr);
-            r->cdr(p);
-            p = r;
-            p->car(q->car());
-            q->car()->inc_ref();
-        }
+/// Rotate left
+static live_obj_ptr
+do_rotl(live_obj_ptr obj)
+{
+        // Wanna list
+    if( !obj->is_list() ){
         obj_unref(obj);
-        assert(p);
-        auto result = static_cast<live_obj_ptr>(p);
-        return(result);
+        return undefined();
     }
 
-    case ROTL:{		// Rotate left
-            // Wanna list
-        if( !obj->is_list() ){
-            obj_unref(obj);
-            return undefined();
-        }
+        // Need two elems, otherwise be ID function
+    if( !obj->at_least(2) ){
+        return(obj);
+    }
+    if( list_unique(obj) ){
+        auto result = list_rotate_unique(obj, true);
+        if( result )
+            return static_cast<live_obj_ptr>(result);
+    }
 
-        obj_ptr p;
-        obj_ptr q;
-            // Need two elems, otherwise be ID function
-        if(
-            !(obj->car()) ||
-            !(q = obj->cdr()) ||
-            !(q->car())
-        ){
-            return(obj);
-        }
+        // Loop, starting from second.  Build parallel list.
+    list_builder b{static_cast<unsigned>(obj->list_length())};
+    list_iter it{obj};
+    auto first = it.elem();
+    for( it.next(); !it.done(); it.next() ){
+        it.elem()->inc_ref();
+        b.push(it.elem());
+    }
+    first->inc_ref();
+    b.push(first);
+    obj_unref(obj);
+    return(b.finish());
+}
 
-        obj_ptr hd = nullptr;
-        obj_ptr *hdp = &hd;
-            // Loop, starting from second.  Build parallel list.
-        for( /* q has obj->cdr() */ ; q; q = q->cdr() ){
-            p = obj_alloc(nullptr);
-            *hdp = p;
-            hdp = p->cdr_addr();
-            p->car(q->car());
-            q->car()->inc_ref();
-        }
-        p = obj_alloc(obj->car());
-        *hdp = p;
-        obj->car()->inc_ref();
+/// Rotate right
+static live_obj_ptr
+do_rotr(live_obj_ptr obj)
+{
+        // Wanna list
+    if( !obj->is_list() ){
         obj_unref(obj);
-        assert(hd);
-        auto result = static_cast<live_obj_ptr>(hd);
-        return(result);
+        return undefined();
     }
 
-    case ROTR:{		// Rotate right
-            // Wanna list
-        if( !obj->is_list() ){
-            obj_unref(obj);
-            return undefined();
-        }
+        // Need two elems, otherwise be ID function
+    if( !obj->at_least(2) ){
+        return(obj);
+    }
+    if( list_unique(obj) ){
+        auto result = list_rotate_unique(obj, false);
+        if( result )
+            return static_cast<live_obj_ptr>(result);
+    }
 
-        obj_ptr p;
-        obj_ptr q;
-            // Need two elems, otherwise be ID function
-        if(
-            !(obj->car()) ||
-            !(q = obj->cdr()) ||
-            !(q->car())
-        ){
-            return(obj);
-        }
+        // Last element first, then the rest stopping one short of end
+    const auto len = static_cast<unsigned>(obj->list_length());
+    list_builder b{len};
+    auto last = list_nth(obj, static_cast<int>(len)-1);
+    assert(last);
+    b.push(static_cast<live_obj_ptr>(last));
+    unsigned x = 1;
+    for( list_iter it{obj}; x < len; it.next(), ++x ){
+        it.elem()->inc_ref();
+        b.push(it.elem());
+    }
+    obj_unref(obj);
+    return(b.finish());
+}
 
-        obj_ptr hd = nullptr;
-        obj_ptr *hdp = &hd;
-            // Loop over list.  Stop one short of end.
-        for( q = obj; q->cdr(); q = q->cdr() ){
-            p = obj_alloc(nullptr);
-            *hdp = p;
-            hdp = p->cdr_addr();
-            p->car(q->car());
-            q->car()->inc_ref();
-        }
-        auto result = obj_alloc(q->car(), hd);
-        q->car()->inc_ref();
+/// Concatenate several lists
+static live_obj_ptr
+do_concat(live_obj_ptr obj)
+{
+    if( !obj->is_list() ){
         obj_unref(obj);
-        return(result);
+        return undefined();
     }
+    if( obj->is_nil() ) return(obj);
 
-    case CONCAT:{		// Concatenate several lists
-        if( !obj->is_list() ){
+        // A first list nobody else sees can take the rest in place
+    auto first = obj->car();
+    if( first && first->is_list() && !first->is_nil() &&
+        list_unique(obj) && list_unique(first) ){
+        auto result = list_concat_unique(first, obj);
+        if( result ){
+            first->inc_ref();
             obj_unref(obj);
-            return undefined();
+            return static_cast<live_obj_ptr>(result);
         }
-        if( !obj->car() ) return(obj);
-        obj_ptr hd = nullptr;
-        obj_ptr *hdp = &hd;
-        for(obj_ptr p = obj; p; p = p->cdr() ){
-            auto q = p->car();
-            if( !q->is_list() ){
-                obj_unref(obj);
-                obj_unref(hd);
-                return undefined();
-            }
-            if( !q->car() )
-                continue;
-            for( ; q; q = q->cdr() ){
-                obj_ptr r;
-                r = obj_alloc(nullptr);
-                *hdp = r;
-                hdp = r->cdr_addr();
-                r->car(q->car());
-                q->car()->inc_ref();
-            }
-        }
-        obj_unref(obj);
-        if( !hd )
-            return(obj_alloc(nullptr));
-        assert(hd);
-        auto result = static_cast<live_obj_ptr>(hd);
-        return(result);
-    }
-
-    case SIN:
-    case COS:
-    case TAN:
-    case ASIN:
-    case ACOS:
-    case ATAN:
-    case EXP:
-    case LOG: {		// log() function
-        return do_math_func(tag, obj);
     }
-    
-    case MOD: {		// Modulo
-        switch( pairtype(obj) ){
-        case pair_type::T_UNDEF:
+    list_builder b;
+    for( list_iter outer{obj}; !outer.done(); outer.next() ){
+        auto q = outer.elem();
+        if( !q->is_list() ){
             obj_unref(obj);
             return undefined();
-        case pair_type::T_FLOAT:
-        case pair_type::T_INT:{
-            const int x1 = static_cast<int>(obj->car()->num_val());
-            const int x2 = static_cast<int>(obj->cadr()->num_val());
-            if( x2 == 0 ){
-                obj_unref(obj);
-                return undefined();
-            }
-            auto p = obj_alloc(x1 % x2);
-            obj_unref(obj);
-            return(p);
         }
+        for( list_iter it{q}; !it.done(); it.next() ){
+            it.elem()->inc_ref();
+            b.push(it.elem());
         }
     }
-    
-    case PAIR:{
-        auto result = do_pair(obj);
-        return result;
-    }
-
-    case SPLIT:{
-        auto result = do_split(obj);
-        return result;
-    }
+    obj_unref(obj);
+    return(b.finish());
+}
 
-    case ATOM:{
-        auto p = do_atom(obj);
+/// Modulo
+static live_obj_ptr
+do_mod(live_obj_ptr obj)
+{
+    switch( pairtype(obj) ){
+    case pair_type::T_UNDEF:
+        obj_unref(obj);
+        return undefined();
+    case pair_type::T_FLOAT:
+    case pair_type::T_INT:{
+        const int x1 = static_cast<int>(obj->car()->num_val());
+        const int x2 = static_cast<int>(obj->cadr()->num_val());
+        if( x2 == 0 ){
+            obj_unref(obj);
+            return undefined();
+        }
+        auto p = obj_alloc(x1 % x2);
+        obj_unref(obj);
         return(p);
     }
-
-    case DIV: {		// Like '/', but forces integer operation
-        switch( pairtype(obj) ){
-            case pair_type::T_UNDEF:
-                obj_unref(obj);
-                return undefined();
-            case pair_type::T_FLOAT:
-            case pair_type::T_INT:{
-                const int x1 = static_cast<int>(obj->car()->num_val());
-                const int x2 = static_cast<int>(obj->cadr()->num_val());
-                if( x2 == 0 ){
-                    obj_unref(obj);
-                    return undefined();
-                }
-                auto p = obj_alloc(x1 / x2);
-                obj_unref(obj);
-                return(p);
-            }
-        }
     }
+    obj_unref(obj);
+    return undefined();
+}
 
-    case NIL: {
-        if( !obj->is_list() ){
+/// Like '/', but forces integer operation
+static live_obj_ptr
+do_div(live_obj_ptr obj)
+{
+    switch( pairtype(obj) ){
+    case pair_type::T_UNDEF:
+        obj_unref(obj);
+        return undefined();
+    case pair_type::T_FLOAT:
+    case pair_type::T_INT:{
+        const int x1 = static_cast<int>(obj->car()->num_val());
+        const int x2 = static_cast<int>(obj->cadr()->num_val());
+        if( x2 == 0 ){
             obj_unref(obj);
             return undefined();
         }
-        bool value;
-        if( obj->car() )
-            value = false;
-        else
-            value = true;
-        auto p = obj_alloc(value);
+        auto p = obj_alloc(x1 / x2);
         obj_unref(obj);
         return(p);
     }
-    
-    case EQ: {
-        return( eqobj(obj) );
     }
-    
-    case AND:
-    case OR:
-    case XOR: {
-        return( do_bool(obj,tag) );
+    obj_unref(obj);
+    return undefined();
+}
+
+/// T if a list is empty
+static live_obj_ptr
+do_null(live_obj_ptr obj)
+{
+    if( !obj->is_list() ){
+        obj_unref(obj);
+        return undefined();
     }
-    case NOT: {
-        if( !obj->is_bool() ){
-            obj_unref(obj);
-            return undefined();
-        }
-        const auto value = !obj->bool_val();
-        auto p = obj_alloc(value);
+    auto p = obj_alloc(obj->is_nil());
+    obj_unref(obj);
+    return(p);
+}
+
+/// Boolean not
+static live_obj_ptr
+do_not(live_obj_ptr obj)
+{
+    if( !obj->is_bool() ){
         obj_unref(obj);
-        return(p);
+        return undefined();
     }
-    
-    default:
-            fatal_err("Unrecognized symbol in do_intrinsics()");
-    } // Switch()
+    const auto value = !obj->bool_val();
+    auto p = obj_alloc(value);
+    obj_unref(obj);
+    return(p);
+}
+
+/// The trig and log functions, which math_intrinsics.cpp does by token
+template <int TOKEN>
+static live_obj_ptr
+do_math(live_obj_ptr obj)
+{
+    return do_math_func(TOKEN, obj);
+}
+
+/// and, or and xor
+template <int TOKEN>
+static live_obj_ptr
+do_logic(live_obj_ptr obj)
+{
+    return do_bool(obj, TOKEN);
 }
 
 /// Common code between distribute-left and -right
@@ -674,60 +623,30 @@ do_dist(
         live_obj_ptr obj, // Source object
         int side)   // Which side to stick on
 {
-    if( !lst->car() ){        // Distributing over NULL list
+    if( lst->is_nil() ){        // Distributing over NULL list
         lst->inc_ref();
         obj_unref(obj);
         return(lst);
     }
 
     /*
-     * Evil C!  Line-by-line, here's what's happening
-     * 1. Get the first list element for the "lower" list
-     * 2. Bind the CAR of it to the distributing object,
-     *    incrementing that object's reference counter.
-     * 3. Get the second element for the "lower" list, bind
-     *    the CDR of the first element to it.
-     * 4. Bind the CAR of the second element to the current
-     *    element in the list being distributed over, increment
-     *    that object's reference count.
-     * 5. Allocate the "upper" list element, build it into the
-     *    chain.
-     * 6. Advance the chain building pointer to be ready to add
-     *    the next element.
-     * 7. Advance to next element of list being distributed over.
-     *
-     *  Gee, wasn't that easy?
+     * Build a pair of the distributing object and each element of the
+     *	list being distributed over, in order.
      */
-    obj_ptr hd;
-    obj_ptr *hdp = &hd;
-    while( lst ){
-        auto r = obj_alloc(nullptr);
+    list_builder b{static_cast<unsigned>(lst->list_length())};
+    for( list_iter it{lst}; !it.done(); it.next() ){
+        auto item = it.take();
+        elem->inc_ref();
+        live_obj_ptr r;
         if( !side ){
-            r->car(elem);
-            elem->inc_ref();
+            r = obj_alloc(elem, obj_alloc(item));
         } else {
-            r->car(lst->car());
-            lst->car()->inc_ref();
+            r = obj_alloc(item, obj_alloc(elem));
         }
-        r->cdr(obj_alloc(nullptr));
-        auto r2 = r->cdr();
-        if( !side ){
-            r2->car(lst->car());
-            lst->car()->inc_ref();
-        } else {
-            r2->car(elem);
-            elem->inc_ref();
-        }
-        *hdp = obj_alloc(nullptr);
-        ((*hdp))->car(r);
-        hdp = (*hdp)->cdr_addr();
-
-        lst = lst->cdr();
+        b.push(r);
     }
     obj_unref(obj);
-    assert(hd);
-    auto result = static_cast<live_obj_ptr>(hd);
-    return(result);
+    return(b.finish());
 }
 
 /// do_trans()--transpose the elements of the "matrix"
@@ -746,60 +665,51 @@ do_trans(live_obj_ptr obj)
         return undefined();
     }
 
-    obj_ptr q;
-    obj_ptr hd = nullptr;
-    obj_ptr *hdp = &hd;
-	// Get how many down (len)
-    int len = p->list_length();
+	// Rows all unboxed vectors of one kind are done as one block copy
+    if( auto q = vec_trans(obj) )
+        return(q);
 
-	/*
-	 * Verify the structure.  Make sure each across is a list,
-	 *	and of the same length.
-	 */
-    for( q = obj; q ; q = q->cdr() ){
-        auto r = q->car();
-        if(
-            (!r->is_list()) ||
-            (r->list_length() != len)
-        ){
+	// Get how many down (len), and a cursor at the head of each across
+    const int len = p->list_length();
+    std::vector<list_iter> rows;
+    for( list_iter it{obj}; !it.done(); it.next() ){
+        auto r = it.elem();
+        if( !r->is_list() ){
             obj_unref(obj);
             return undefined();
         }
-    }
-
-	// By definition, list of NULL lists returns <>
-    if( len == 0 ){
-        obj_unref(obj);
-        return( obj_alloc(nullptr) );
+        rows.emplace_back(r);
     }
 
 	/*
-	 * Here is an O(n^3) way of building a transposed matrix.
-	 *	Loop over each depth, building across.  I'm so debonnair
-	 *	about it because I never use this blinking function.
+	 * Build each down from the next element of every across, moving
+	 *	all the cursors along together.  An across which runs out
+	 *	before the others, or after, makes the whole thing undefined;
+	 *	the builders drop what was built so far.
 	 */
-    for(int x = 0; x < len; ++x ){
-        obj_ptr s = obj_alloc(nullptr);
-        obj_ptr hd2 = nullptr;
-        obj_ptr *hdp2 = &hd2;
-
-        *hdp = s;
-        hdp = s->cdr_addr();
-        for( p = obj; p; p = p->cdr() ){
-            q = p->car();
-            for(int y = 0; y < x; ++y )
-                q = q->cdr();
-            q = q->car();
-            auto r = obj_alloc(nullptr);
-            *hdp2 = r;
-            hdp2 = r->cdr_addr();
-            r->car(q);
-            q->inc_ref();
+    list_builder down{static_cast<unsigned>(len)};
+    for( int x = 0; x < len; ++x ){
+        list_builder across{static_cast<unsigned>(rows.size())};
+        for( auto &r: rows ){
+            if( r.done() ){
+                obj_unref(obj);
+                return undefined();
+            }
+            across.push(r.take());
+            r.next();
+        }
+        down.push(across.finish());
+    }
+    for( auto &r: rows ){
+        if( !r.done() ){
+            obj_unref(obj);
+            return undefined();
         }
-        s->car(hd2);
     }
     obj_unref(obj);
-    return(hd);
+
+	// By definition, list of NULL lists returns <>
+    return(down.finish());
 }
 
 /// do_bool()--do the three boolean binary operators
@@ -841,3 +751,85 @@ do_bool(live_obj_ptr obj, int op)
     obj_unref(obj);
     return(r);
 }
+
+    /*
+     * Each intrinsic the grammar has a token for, with its handler.
+     *	T, F and while are tokens too, but parse as keywords, so
+     *	symtab_init() stuffs those itself.
+     */
+static const struct {
+    const char *name;
+    int token;
+    intrinsic_fn fn;
+} builtins[] = {
+    { "and", AND, do_logic<AND> },
+    { "or", OR, do_logic<OR> },
+    { "xor", XOR, do_logic<XOR> },
+    { "sin", SIN, do_math<SIN> },
+    { "cos", COS, do_math<COS> },
+    { "tan", TAN, do_math<TAN> },
+    { "asin", ASIN, do_math<ASIN> },
+    { "acos", ACOS, do_math<ACOS> },
+    { "atan", ATAN, do_math<ATAN> },
+    { "log", LOG, do_math<LOG> },
+    { "exp", EXP, do_math<EXP> },
+    { "mod", MOD, do_mod },
+    { "concat", CONCAT, do_concat },
+    { "last", LAST, do_last },
+    { "first", FIRST, do_hd },
+    { "tl", TL, do_tl },
+    { "hd", HD, do_hd },
+    { "id", ID, do_id },
+    { "atom", ATOM, do_atom },
+    { "eq", EQ, eqobj },
+    { "not", NOT, do_not },
+    { "null", NIL, do_null },
+    { "reverse", REVERSE, do_reverse },
+    { "distl", DISTL, do_distl },
+    { "distr", DISTR, do_distr },
+    { "length", LENGTH, do_length },
+    { "trans", TRANS, do_trans },
+    { "apndl", APNDL, do_apndl },
+    { "apndr", APNDR, do_apndr },
+    { "tlr", TLR, do_tlr },
+    { "front", FRONT, do_tlr },
+    { "rotl", ROTL, do_rotl },
+    { "rotr", ROTR, do_rotr },
+    { "iota", IOTA, do_iota },
+    { "pair", PAIR, do_pair },
+    { "split", SPLIT, do_split },
+    { "out", OUT, do_out },
+    { "pick", PICK, do_pick },
+    { "div", DIV, do_div },
+};
+
+void
+intrin_register(const char *name, intrinsic_fn fn, int token)
+{
+    assert(name);
+    assert(fn);
+    auto p = lookup(name);
+    if( p->type() != symtype::SYM_NEW )
+        fatal_err("Dup init in intrin_register()");
+    p->type(symtype::SYM_BUILTIN);
+    p->sym_val.YYint = token ? token : INTRINSIC;
+    p->sym_fn = fn;
+}
+
+    /*
+     * Of the intrinsics the grammar knows, only out prints.  Those added
+     *	without a token may do anything, so they are taken to print too.
+     */
+bool
+intrin_prints(sym_ptr sym)
+{
+    const int token = sym->sym_val.YYint;
+    return( token == OUT || token == INTRINSIC );
+}
+
+void
+intrin_init(void)
+{
+    for( auto &b: builtins )
+        intrin_register(b.name, b.fn, b.token);
+}
@@ -1,6 +1,12 @@
 #ifndef INTRIN_H
 #define INTRIN_H
 
-live_obj_ptr do_intrinsics(live_sym_ptr act, live_obj_ptr obj);
+//intrin.c
+/// intrin_init()--enter each intrinsic in the symbol table, with its handler
+void intrin_init(void);
+/// intrin_register()--make name an intrinsic run by fn; token is the grammar's own token for it, if any, else 0
+void intrin_register(const char * _Nonnull name, intrinsic_fn fn, int token = 0);
+/// intrin_prints()--true if the intrinsic sym may print: out, or one added without a token of its own
+bool intrin_prints(sym_ptr _Nonnull sym);
 
 #endif
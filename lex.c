@@ -9,7 +9,14 @@
 #include <unistd.h>
 #include "fpcommon.h"
 #include "lex.h"
+#include "depth.h"
+#include "memo.h"
+#include "obj.h"
+#include "optimize.h"
+#include "par.h"
+#include "reclaim.h"
 #include "symtab.h"
+#include "vm.h"
 #include "yystype.h"
 #include "symtab_entry.hpp"
 #include "y.tab.h"
@@ -254,9 +261,64 @@ load()
     return;
 }
 
+/// Show the call depth limit, or set it from a number on the same line
+static void
+depth()
+{
+    int c;
+    while( (c = nextc()) == ' ' || c == '\t' )
+        ;
+    unsigned calls = 0;
+    while( isdigit(c) ){
+        calls = calls * 10 + static_cast<unsigned>(c - '0');
+        c = nextc();
+    }
+    stack.ungetc(c);
+    depth_set(calls);
+}
+
+/// Set how many threads &, constructions and | use from a number on the same line, or toggle it
+static void
+par()
+{
+    int c;
+    while( (c = nextc()) == ' ' || c == '\t' )
+        ;
+    unsigned threads = 0;
+    while( isdigit(c) ){
+        threads = threads * 10 + static_cast<unsigned>(c - '0');
+        c = nextc();
+    }
+    stack.ungetc(c);
+    par_set(threads);
+}
+
+/// Keep the results of the function named on the same line, or show how that's going
+static void
+memo()
+{
+    int c;
+    while( (c = nextc()) == ' ' || c == '\t' )
+        ;
+    char name[LINELENGTH]{};
+    size_t index = 0;
+    while( isalnum(c) && index + 1 < sizeof(name) ){
+        name[index++] = static_cast<char>(c);
+        c = nextc();
+    }
+    stack.ungetc(c);
+    if( index )
+        memo_toggle(name);
+    else
+        memo_stats();
+}
+
 static void help();
 [[noreturn]] static void quit();
 static void load();
+static void depth();
+static void memo();
+static void par();
 
 struct command
 {
@@ -270,9 +332,20 @@ static const command commands[] =
     {"load", load, " load - redirect input from a file\n"},
     {"quit", quit, " quit - leave FP\n"},
     {"help", help, " help - this message\n"},
+    {"bgfree", reclaim_toggle, " bgfree - toggle freeing big lists in the background\n"},
+    {"arena", obj_arena_toggle, " arena - toggle arena allocation for each application\n"},
+    {"vm", vm_toggle, " vm - toggle running compiled bytecode\n"},
+    {"opt", opt_toggle, " opt - toggle rewriting functions by the laws of FP\n"},
+    {"optshow", opt_show_toggle, " optshow - toggle printing functions as rewritten\n"},
+    {"depth", depth, " depth [n] - show or set how deep function calls may nest\n"},
+    {"memo", memo, " memo [name] - toggle keeping the results of name, or show what's kept\n"},
+    {"par", par, " par [n] - toggle or set how many threads &, [f,g] and | use\n"},
 #ifdef YYDEBUG
     {"yydebug", flipyydebug, " yydebug - toggle parser tracing\n"},
 #endif
+#ifdef MEMSTAT
+    {"memstat", obj_memstat, " memstat - show object slab occupancy\n"},
+#endif
 };
 
 [[noreturn]] static void
@@ -328,6 +401,10 @@ fp_cmd(void)
         }
     }
     cmd[index] = '\0';
+
+	// Leave the rest of the line, if any, to the command
+    if( c != EOF )
+        stack.ungetc(c);
     
     for(const auto &iter : commands)
     {
@@ -0,0 +1,414 @@
+/*
+ * list.cpp--operations on lists which don't care how the list is stored
+ */
+#include <algorithm>
+#include <string.h>
+#include "fpcommon.h"
+#include "list.h"
+#include "obj.h"
+#include "object.hpp"
+#include "list_builder.hpp"
+#include "list_iter.hpp"
+
+/// A new view of count elements of vector v, starting x elements in
+static live_obj_ptr
+vec_view(live_obj_ptr v, unsigned x, unsigned count)
+{
+    if( count == 0 )
+        return obj_alloc(nullptr);
+    auto store = v->vec_store_as_is();
+    store->add_ref();
+    return obj_alloc(store, v->vec_offset() + x, count);
+}
+
+obj_ptr
+list_nth(live_obj_ptr lst, int x)
+{
+    assert(lst->is_list());
+    assert(x >= 0);
+    obj_ptr p = lst;
+    while( p ){
+        if( p->is_vector() ){
+            if( static_cast<unsigned>(x) >= p->vec_length() )
+                return(nullptr);
+            if( p->is_range() )
+                return obj_alloc(p->range_elem(static_cast<unsigned>(x)));
+            auto q = p->vec_elem(static_cast<unsigned>(x));
+            q->inc_ref();
+            return(q);
+        }
+        auto q = p->car();
+        if( !q )
+            return(nullptr);
+        if( x == 0 ){
+            q->inc_ref();
+            return(q);
+        }
+        --x;
+        p = p->cdr();
+    }
+    return(nullptr);
+}
+
+live_obj_ptr
+list_drop(live_obj_ptr lst, int n)
+{
+    assert(lst->at_least(n));
+    obj_ptr p = lst;
+    while( n > 0 && p && p->is_cons() ){
+        p = p->cdr();
+        --n;
+    }
+    if( !p ){
+        assert(n == 0);
+        return obj_alloc(nullptr);
+    }
+    if( p->is_vector() && n > 0 ){
+        auto v = static_cast<live_obj_ptr>(p);
+        auto x = static_cast<unsigned>(n);
+        return vec_view(v, x, v->vec_length() - x);
+    }
+    p->inc_ref();
+    return static_cast<live_obj_ptr>(p);
+}
+
+live_obj_ptr
+list_take(live_obj_ptr lst, int n)
+{
+    assert(lst->at_least(n));
+    if( lst->is_vector() )
+        return vec_view(lst, 0, static_cast<unsigned>(n));
+    list_builder b{static_cast<unsigned>(n)};
+    for( list_iter it{lst}; n > 0; it.next(), --n ){
+        auto p = it.elem();
+        p->inc_ref();
+        b.push(p);
+    }
+    return b.finish();
+}
+
+    /*
+     * A list laid out in a store of its own, so that list_take() and
+     *	list_drop() of it are views.  The elements are kept as they
+     *	are, not unboxed as list_builder would.
+     */
+live_obj_ptr
+list_vector(live_obj_ptr lst)
+{
+    if( lst->is_vector() || lst->is_nil() )
+        return(lst);
+    const auto n = static_cast<unsigned>(lst->list_length());
+    auto store = vector_store::create(n);
+    for( list_iter it{lst}; !it.done(); it.next() )
+        store->elems()[store->length++] = it.take();
+    obj_unref(lst);
+    return obj_alloc(store, 0, n);
+}
+
+    /*
+     * Structural hashing.  A number hashes by its value as a double, so
+     *	1 and 1.0, which same() calls equal, hash alike; so do 0 and -0.0.
+     */
+static unsigned long long
+num_hash(double d)
+{
+    if( d == 0 )
+        return(0);
+    unsigned long long bits;
+    memcpy(&bits, &d, sizeof(bits));
+    bits ^= bits >> 31;
+    bits *= 0xbf58476d1ce4e5b9ULL;
+    return bits ^ (bits >> 29);
+}
+
+/// Fold one element's hash into a running list hash
+static unsigned long long
+mix(unsigned long long h, unsigned long long x)
+{
+    return (h ^ x) * 0x100000001b3ULL;
+}
+
+static unsigned long long
+elem_hash(live_obj_ptr p)
+{
+    switch( p->type() ){
+    case obj_type::T_INT:
+        return num_hash(p->int_val());
+    case obj_type::T_FLOAT:
+        return num_hash(p->float_val());
+    case obj_type::T_BOOL:
+        return p->bool_val() ? 1 : 2;
+    case obj_type::T_LIST:
+    case obj_type::T_VECTOR:
+        return list_hash(p);
+    case obj_type::T_UNDEF:
+        return(3);
+    }
+    return(3);
+}
+
+unsigned
+list_hash(live_obj_ptr lst)
+{
+    assert(lst->is_list());
+    if( lst->cached_hash() )
+        return lst->cached_hash();
+
+    unsigned long long h = 0xcbf29ce484222325ULL;
+    obj_ptr p = lst;
+    while( p && p->is_cons() && p->car() ){
+        h = mix(h, elem_hash(static_cast<live_obj_ptr>(p->car())));
+        p = p->cdr();
+    }
+    if( p && p->is_vector() ){
+        auto store = p->vec_store();
+        const auto start = p->vec_offset();
+        const auto end = start + p->vec_length();
+        switch( store->kind ){
+        case store_kind::OBJECTS:
+            for( auto x = start; x < end; ++x )
+                h = mix(h, elem_hash(static_cast<live_obj_ptr>(store->elems()[x])));
+            break;
+        case store_kind::INTS:
+            for( auto x = start; x < end; ++x )
+                h = mix(h, num_hash(store->ints()[x]));
+            break;
+        case store_kind::DOUBLES:
+            for( auto x = start; x < end; ++x )
+                h = mix(h, num_hash(store->doubles()[x]));
+            break;
+        }
+    }
+
+	// Down to 16 bits, keeping 0 for "not worked out yet"
+    h ^= h >> 32;
+    h ^= h >> 16;
+    auto hash = static_cast<unsigned short>(h);
+    if( !hash )
+        hash = 1;
+    if( !lst->is_immortal() )
+        lst->cache_hash(hash);
+    return(hash);
+}
+
+constexpr unsigned list_builder::VECTOR_MIN;
+
+list_builder::list_builder(unsigned n)
+: expected{n}
+{
+    if( expected >= VECTOR_MIN )
+        store = vector_store::create(expected);
+}
+
+list_builder::~list_builder()
+{
+    for( unsigned x = 0; x < nsmall; ++x )
+        obj_unref(small[x]);
+    if( store ){
+        if( !store->is_packed() ){
+            auto elems = store->elems();
+            for( unsigned x = 0; x < store->length; ++x )
+                obj_unref(elems[x]);
+        }
+        vector_store::destroy(store);
+    }
+}
+
+void
+list_builder::spill(unsigned n)
+{
+    assert(!store);
+    store = vector_store::create(std::max(n, nsmall));
+    std::copy(small, small + nsmall, store->elems());
+    store->length = nsmall;
+    nsmall = 0;
+}
+
+void
+list_builder::reserve()
+{
+    assert(store);
+    if( store->length < store->capacity )
+        return;
+    auto bigger = vector_store::create(2 * store->capacity, store->kind);
+    switch( store->kind ){
+    case store_kind::OBJECTS:
+        std::copy(store->elems(), store->elems() + store->length, bigger->elems());
+        break;
+    case store_kind::INTS:
+        std::copy(store->ints(), store->ints() + store->length, bigger->ints());
+        break;
+    case store_kind::DOUBLES:
+        std::copy(store->doubles(), store->doubles() + store->length, bigger->doubles());
+        break;
+    }
+    bigger->length = store->length;
+    vector_store::destroy(store);
+    store = bigger;
+}
+
+bool
+list_builder::start_packed(store_kind kind)
+{
+    if( store && store->kind == kind )
+        return(true);
+    if( size() != 0 )
+        return(false);
+    if( store )
+        vector_store::destroy(store);
+    store = vector_store::create(std::max(expected, VECTOR_MIN), kind);
+    return(true);
+}
+
+void
+list_builder::unpack()
+{
+    assert(store && store->is_packed());
+    auto packed = store;
+    store = vector_store::create(packed->capacity);
+    auto elems = store->elems();
+    for( unsigned x = 0; x < packed->length; ++x ){
+        if( packed->kind == store_kind::INTS )
+            elems[x] = obj_alloc(packed->ints()[x]);
+        else
+            elems[x] = obj_alloc(packed->doubles()[x]);
+    }
+    store->length = packed->length;
+    common = packed->kind;
+    vector_store::destroy(packed);
+}
+
+void
+list_builder::pack()
+{
+    assert(store && !store->is_packed());
+    assert(common != store_kind::OBJECTS);
+    const auto n = store->length;
+    auto packed = vector_store::create(n, common);
+    auto elems = store->elems();
+    for( unsigned x = 0; x < n; ++x ){
+        if( common == store_kind::INTS )
+            packed->ints()[x] = elems[x]->int_val();
+        else
+            packed->doubles()[x] = elems[x]->float_val();
+    }
+    packed->length = n;
+
+	// The objects we were given stay on as the boxes
+    packed->make_boxes();
+    std::copy(elems, elems + n, packed->boxes);
+    vector_store::destroy(store);
+    store = packed;
+}
+
+void
+list_builder::push(live_obj_ptr p)
+{
+    if( store && store->is_packed() ){
+        if( store->kind == store_kind::INTS && p->is_int() ){
+            push(p->int_val());
+            obj_unref(p);
+            return;
+        }
+        if( store->kind == store_kind::DOUBLES && p->is_float() ){
+            push(p->float_val());
+            obj_unref(p);
+            return;
+        }
+        unpack();
+    }
+
+	// Keep track of whether this could be an unboxed list
+    store_kind kind = store_kind::OBJECTS;
+    if( p->is_int() )
+        kind = store_kind::INTS;
+    else if( p->is_float() )
+        kind = store_kind::DOUBLES;
+    if( size() == 0 )
+        common = kind;
+    else if( common != kind )
+        common = store_kind::OBJECTS;
+
+    if( !store ){
+        if( nsmall < VECTOR_MIN ){
+            small[nsmall++] = p;
+            return;
+        }
+        spill(2 * VECTOR_MIN);
+    }
+    reserve();
+    store->elems()[store->length++] = p;
+}
+
+void
+list_builder::push(int value)
+{
+    if( !start_packed(store_kind::INTS) ){
+        push(obj_alloc(value));
+        return;
+    }
+    reserve();
+    store->ints()[store->length++] = value;
+}
+
+void
+list_builder::push(double value)
+{
+    if( !start_packed(store_kind::DOUBLES) ){
+        push(obj_alloc(value));
+        return;
+    }
+    reserve();
+    store->doubles()[store->length++] = value;
+}
+
+void
+list_builder::reverse()
+{
+    if( !store )
+        std::reverse(small, small + nsmall);
+    else switch( store->kind ){
+    case store_kind::OBJECTS:
+        std::reverse(store->elems(), store->elems() + store->length);
+        break;
+    case store_kind::INTS:
+        std::reverse(store->ints(), store->ints() + store->length);
+        break;
+    case store_kind::DOUBLES:
+        std::reverse(store->doubles(), store->doubles() + store->length);
+        break;
+    }
+}
+
+live_obj_ptr
+list_builder::finish()
+{
+    if( store && store->length < VECTOR_MIN && store->is_packed() )
+        unpack();
+    obj_ptr *elems = small;
+    unsigned n = nsmall;
+    if( store ){
+        n = store->length;
+        if( n >= VECTOR_MIN ){
+            if( !store->is_packed() && common != store_kind::OBJECTS )
+                pack();
+            auto result = obj_alloc(store, 0, n);
+            store = nullptr;
+            return(result);
+        }
+        elems = store->elems();
+    }
+
+	// Short enough to be a plain chain of cons cells
+    obj_ptr hd = nullptr;
+    for( unsigned x = n; x > 0; --x )
+        hd = obj_alloc(elems[x - 1], hd);
+    nsmall = 0;
+    if( store ){
+        vector_store::destroy(store);
+        store = nullptr;
+    }
+    if( !hd )
+        return obj_alloc(nullptr);
+    return static_cast<live_obj_ptr>(hd);
+}
@@ -0,0 +1,34 @@
+#ifndef LIST_H
+#define LIST_H
+
+//list.cpp
+/// list_nth()--referenced x'th (from 0) element of lst, or null if too short
+obj_ptr list_nth(live_obj_ptr lst, int x);
+/// list_drop()--referenced list of all but the first n elements of lst
+live_obj_ptr list_drop(live_obj_ptr lst, int n);
+/// list_take()--new list of the first n elements of lst
+live_obj_ptr list_take(live_obj_ptr lst, int n);
+/// list_vector()--lst, whose reference we take, as a vector of the same elements
+live_obj_ptr list_vector(live_obj_ptr lst);
+/// list_hash()--structural hash of lst, cached in it; equal lists hash alike
+unsigned list_hash(live_obj_ptr lst);
+
+//list_inplace.cpp
+/// list_unique()--tell if the caller holds the only way to reach lst's spine
+bool list_unique(live_obj_ptr lst);
+    /*
+     * These update a list for which list_unique() holds, handing back
+     *	the changed list, or null (with lst untouched) if they can't.
+     */
+/// list_append_unique()--add p, whose reference we take, to the end of lst
+obj_ptr list_append_unique(live_obj_ptr lst, live_obj_ptr p);
+/// list_concat_unique()--add all of the lists after the first in lists to lst
+obj_ptr list_concat_unique(live_obj_ptr lst, live_obj_ptr lists);
+/// list_reverse_unique()--reverse lst
+obj_ptr list_reverse_unique(live_obj_ptr lst);
+/// list_rotate_unique()--rotate lst one place left or right
+obj_ptr list_rotate_unique(live_obj_ptr lst, bool left);
+/// list_drop_last_unique()--remove the last element of lst
+obj_ptr list_drop_last_unique(live_obj_ptr lst);
+
+#endif
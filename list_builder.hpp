@@ -0,0 +1,73 @@
+#ifndef LIST_BUILDER_HPP
+#define LIST_BUILDER_HPP
+
+#include "vector_store.hpp"
+
+/**
+ * Collects objects into a new list, replacing the old hd/hdp idiom.
+ *	Short lists come out as a chain of cons cells; once a list reaches
+ *	VECTOR_MIN elements it comes out as a T_VECTOR instead.  The builder
+ *	owns each reference pushed into it until finish(); if it is
+ *	destroyed first it drops them.
+ *
+ * A vector whose elements turn out to be all ints or all floats is
+ *	finished as an unboxed store.  Callers which produce raw numbers
+ *	can push them as such and never make the objects at all.
+ */
+struct list_builder final {
+    /// Lists at least this long are built as vectors
+    static constexpr unsigned VECTOR_MIN = 8;
+
+    list_builder() = default;
+    /// Start with room for the number of elements the caller expects
+    explicit list_builder(unsigned expected);
+    ~list_builder();
+    list_builder(const list_builder &) = delete;
+    list_builder &operator=(const list_builder &) = delete;
+
+    /// Add an element to the end, taking over the caller's reference
+    void push(live_obj_ptr p);
+
+    /// Add an int to the end, unboxed if the list stays all ints
+    void push(int value);
+
+    /// Add a float to the end, unboxed if the list stays all floats
+    void push(double value);
+
+    /// Number of elements pushed so far
+    unsigned size() const
+    {
+        return store ? store->length : nsmall;
+    }
+
+    /// Reverse the elements pushed so far
+    void reverse();
+
+    /// Hand back the finished list; the builder is left empty
+    live_obj_ptr finish();
+
+private:
+    /// Move the short list out to a store with room for n elements
+    void spill(unsigned n);
+
+    /// Make sure the store has room for one more element
+    void reserve();
+
+    /// Start an unboxed store of the given kind, if nothing is pushed yet
+    bool start_packed(store_kind kind);
+
+    /// Box the elements of an unboxed store, so any object may follow
+    void unpack();
+
+    /// Swap the finished store of objects for an unboxed one
+    void pack();
+
+    obj_ptr small[VECTOR_MIN];
+    unsigned nsmall = 0;
+    unsigned expected = 0;
+    vector_store * _Nullable store = nullptr;
+    /// What the objects pushed so far have in common
+    store_kind common = store_kind::OBJECTS;
+};
+
+#endif
@@ -0,0 +1,311 @@
+/*
+ * list_inplace.cpp--update lists in place when nobody else can see them
+ *
+ *	An intrinsic which rebuilds its argument normally copies the whole
+ *	spine, since some other object may share it.  When the caller's
+ *	reference is the only one, all the way down the spine, nobody can
+ *	tell the difference if we rearrange the cells and slots we have,
+ *	so these do that instead.  Each returns null, leaving the list
+ *	untouched, if the list isn't laid out in a way it handles; the
+ *	caller then copies as before.
+ */
+#include <algorithm>
+#include "fpcommon.h"
+#include "list.h"
+#include "obj.h"
+#include "object.hpp"
+#include "list_builder.hpp"
+#include "list_iter.hpp"
+
+bool
+list_unique(live_obj_ptr lst)
+{
+    assert(lst->is_list());
+    if( !lst->is_unique() )
+        return(false);
+    obj_ptr p = lst;
+    while( p && p->is_cons() && p->car() ){
+        if( !p->is_unique() )
+            return(false);
+        p = p->cdr();
+    }
+    if( p && p->is_vector() )
+        return p->is_unique() && p->vec_store()->unique();
+    return(true);
+}
+
+/// Drop the cached hashes of a list we've changed, handing it back
+static live_obj_ptr
+changed(live_obj_ptr lst)
+{
+    obj_ptr p = lst;
+    while( p && p->is_cons() ){
+        p->forget_hash();
+        p = p->cdr();
+    }
+    if( p )
+        p->forget_hash();
+    return(lst);
+}
+
+/// Apply f to the view's part of each array in its store (slots, boxes)
+template <typename F>
+static void
+each_array(live_obj_ptr v, F f)
+{
+    auto store = v->vec_store();
+    const auto start = v->vec_offset();
+    const auto end = start + v->vec_length();
+    switch( store->kind ){
+    case store_kind::OBJECTS:
+        f(store->elems() + start, store->elems() + end);
+        break;
+    case store_kind::INTS:
+        f(store->ints() + start, store->ints() + end);
+        break;
+    case store_kind::DOUBLES:
+        f(store->doubles() + start, store->doubles() + end);
+        break;
+    }
+    if( store->boxes )
+        f(store->boxes + start, store->boxes + end);
+}
+
+/// Drop whatever store slot x holds
+static void
+drop_slot(vector_store * _Nonnull store, unsigned x)
+{
+    if( !store->is_packed() )
+        obj_unref(store->elems()[x]);
+    else if( store->boxes ){
+        obj_unref(store->boxes[x]);
+        store->boxes[x] = nullptr;
+    }
+}
+
+    /*
+     * Make sure the slots right after unique vector v are free for more
+     *	elements.  If v doesn't end at the end of its store, or the store
+     *	is full, v moves to a bigger store of its own; slots the old store
+     *	held outside v (left over from an earlier tl or tlr) are dropped.
+     */
+static vector_store * _Nonnull
+make_room(live_obj_ptr v, unsigned more)
+{
+    auto store = v->vec_store();
+    const auto start = v->vec_offset();
+    const auto n = v->vec_length();
+    if( start + n == store->length && store->length + more <= store->capacity )
+        return(store);
+
+    auto bigger = vector_store::create(2 * (n + more), store->kind);
+    switch( store->kind ){
+    case store_kind::OBJECTS:
+        std::copy(store->elems() + start, store->elems() + start + n, bigger->elems());
+        break;
+    case store_kind::INTS:
+        std::copy(store->ints() + start, store->ints() + start + n, bigger->ints());
+        break;
+    case store_kind::DOUBLES:
+        std::copy(store->doubles() + start, store->doubles() + start + n, bigger->doubles());
+        break;
+    }
+    if( store->boxes ){
+        bigger->make_boxes();
+        std::copy(store->boxes + start, store->boxes + start + n, bigger->boxes);
+    }
+    bigger->length = n;
+    for( unsigned x = 0; x < store->length; ++x ){
+        if( x < start || x >= start + n )
+            drop_slot(store, x);
+    }
+    vector_store::destroy(store);
+    v->vec_reseat(bigger, 0, n);
+    return(bigger);
+}
+
+/// Tell if p can go in a slot of store
+static bool
+fits(vector_store * _Nonnull store, live_obj_ptr p)
+{
+    switch( store->kind ){
+    case store_kind::OBJECTS:
+        return(true);
+    case store_kind::INTS:
+        return p->is_int();
+    case store_kind::DOUBLES:
+        return p->is_float();
+    }
+    return(false);
+}
+
+/// Put p, whose reference we take, in the next slot of a store with room
+static void
+put_slot(vector_store * _Nonnull store, live_obj_ptr p)
+{
+    const auto x = store->length++;
+    switch( store->kind ){
+    case store_kind::OBJECTS:
+        store->elems()[x] = p;
+        return;
+    case store_kind::INTS:
+        store->ints()[x] = p->int_val();
+        break;
+    case store_kind::DOUBLES:
+        store->doubles()[x] = p->float_val();
+        break;
+    }
+    if( store->boxes )
+        store->boxes[x] = p;
+    else
+        obj_unref(p);
+}
+
+/// The last cell of a chain, or its vector tail
+static live_obj_ptr
+last_link(live_obj_ptr lst)
+{
+    obj_ptr p = lst;
+    while( p->is_cons() && p->cdr() )
+        p = p->cdr();
+    return static_cast<live_obj_ptr>(p);
+}
+
+obj_ptr
+list_append_unique(live_obj_ptr lst, live_obj_ptr p)
+{
+    assert(!lst->is_nil());
+    auto last = last_link(lst);
+    if( last->is_cons() ){
+	    // A chain long enough to be a vector is left to be copied as one
+        if( static_cast<unsigned>(lst->list_length()) + 1 >= list_builder::VECTOR_MIN )
+            return(nullptr);
+        last->cdr(obj_alloc(p));
+        return changed(lst);
+    }
+    if( !fits(last->vec_store(), p) )
+        return(nullptr);
+    auto store = make_room(last, 1);
+    put_slot(store, p);
+    last->vec_reseat(store, last->vec_offset(), last->vec_length() + 1);
+    return changed(lst);
+}
+
+obj_ptr
+list_concat_unique(live_obj_ptr lst, live_obj_ptr lists)
+{
+    if( !lst->is_vector() )
+        return(nullptr);
+
+	// Check that it all fits before touching anything
+    auto store = lst->vec_store();
+    unsigned more = 0;
+    list_iter rest{lists};
+    for( rest.next(); !rest.done(); rest.next() ){
+        auto l = rest.elem();
+        if( !l->is_list() )
+            return(nullptr);
+        for( list_iter it{l}; !it.done(); it.next() ){
+            if( !fits(store, it.elem()) )
+                return(nullptr);
+            ++more;
+        }
+    }
+
+    store = make_room(lst, more);
+    rest = list_iter{lists};
+    for( rest.next(); !rest.done(); rest.next() ){
+        for( list_iter it{rest.elem()}; !it.done(); it.next() ){
+            it.elem()->inc_ref();
+            put_slot(store, it.elem());
+        }
+    }
+    lst->vec_reseat(store, lst->vec_offset(), lst->vec_length() + more);
+    return changed(lst);
+}
+
+obj_ptr
+list_reverse_unique(live_obj_ptr lst)
+{
+    if( lst->is_vector() ){
+        each_array(lst, [](auto begin, auto end){ std::reverse(begin, end); });
+        return changed(lst);
+    }
+
+	// Turn the links of a plain chain around
+    obj_ptr prev = nullptr;
+    obj_ptr p = lst;
+    for( obj_ptr q = p; q; q = q->cdr() ){
+        if( !q->is_cons() )
+            return(nullptr);
+    }
+    while( p ){
+        auto next = p->cdr();
+        p->cdr(prev);
+        prev = p;
+        p = next;
+    }
+    return changed(static_cast<live_obj_ptr>(prev));
+}
+
+obj_ptr
+list_rotate_unique(live_obj_ptr lst, bool left)
+{
+    if( lst->is_vector() ){
+        if( left )
+            each_array(lst, [](auto begin, auto end){ std::rotate(begin, begin + 1, end); });
+        else
+            each_array(lst, [](auto begin, auto end){ std::rotate(begin, end - 1, end); });
+        return changed(lst);
+    }
+
+	// Only plain chains of two or more
+    obj_ptr before_last = nullptr;
+    obj_ptr last = lst;
+    while( last->cdr() ){
+        if( !last->cdr()->is_cons() )
+            return(nullptr);
+        before_last = last;
+        last = last->cdr();
+    }
+    if( !before_last )
+        return(nullptr);
+    if( left ){
+        auto hd = lst->cdr();
+        lst->cdr(nullptr);
+        last->cdr(lst);
+        return changed(static_cast<live_obj_ptr>(hd));
+    }
+    before_last->cdr(nullptr);
+    last->cdr(lst);
+    return changed(static_cast<live_obj_ptr>(last));
+}
+
+obj_ptr
+list_drop_last_unique(live_obj_ptr lst)
+{
+    auto last = last_link(lst);
+    if( last->is_vector() ){
+        const auto n = last->vec_length();
+        if( n == 1 )
+            return(nullptr);
+        auto store = last->vec_store();
+        const auto end = last->vec_offset() + n;
+        if( end == store->length ){
+            drop_slot(store, end - 1);
+            store->length--;
+        }
+        last->vec_reseat(store, last->vec_offset(), n - 1);
+        return changed(lst);
+    }
+    if( last == lst )
+        return(nullptr);
+
+	// Unhook the last cell of a plain chain
+    obj_ptr p = lst;
+    while( p->cdr() != last )
+        p = p->cdr();
+    p->cdr(nullptr);
+    obj_unref(last);
+    return changed(lst);
+}
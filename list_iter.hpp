@@ -0,0 +1,84 @@
+#ifndef LIST_ITER_HPP
+#define LIST_ITER_HPP
+
+#include "obj.h"
+#include "object.hpp"
+
+/**
+ * Walks the elements of a list, whether it is a chain of cons cells, a
+ *	vector, or a chain ending in a vector.  The elements are borrowed
+ *	from the list; add a reference to any you want to keep, or take()
+ *	them, which leaves a range unwritten.
+ */
+struct list_iter final {
+    explicit list_iter(obj_ptr lst)
+    {
+        assert(!lst || lst->is_list());
+        start(lst);
+    }
+
+    /// true once every element has been visited
+    bool done() const
+    {
+        return !cell && !vec;
+    }
+
+    /// The current element
+    live_obj_ptr elem() const
+    {
+        obj_ptr p;
+        if( vec )
+            p = vec->vec_elem(index);
+        else {
+            assert(cell);
+            p = cell->car();
+        }
+        assert(p);
+        return static_cast<live_obj_ptr>(p);
+    }
+
+    /// The current element, referenced for the caller; a range's is made afresh
+    live_obj_ptr take() const
+    {
+        if( range )
+            return obj_alloc(vec->range_elem(index));
+        auto p = elem();
+        p->inc_ref();
+        return(p);
+    }
+
+    /// Step to the next element
+    void next()
+    {
+        if( vec ){
+            if( ++index == vec->vec_length() )
+                vec = nullptr;
+            return;
+        }
+        assert(cell);
+        start(cell->cdr());
+    }
+
+private:
+    /// Position ourselves at the head of (the rest of) a list
+    void start(obj_ptr p)
+    {
+        cell = nullptr;
+        vec = nullptr;
+        index = 0;
+        if( !p )
+            return;
+        if( p->is_vector() ){
+            vec = p;
+            range = p->is_range();
+        } else if( p->car() )
+            cell = p;
+    }
+
+    obj_ptr cell = nullptr;
+    obj_ptr vec = nullptr;
+    unsigned index = 0;
+    bool range = false;
+};
+
+#endif
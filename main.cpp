@@ -2,9 +2,12 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include "fpcommon.h"
+#include "depth.h"
 #include "lex.h"
+#include "obj.h"
 #include "signal_handling.h"
 #include "symtab.h"
+#include "vm.h"
 
 jmp_buf restart;
 
@@ -14,6 +17,8 @@ int yyparse(void);
 int
 main(void)
 {
+    depth_init();
+    obj_init();
     symtab_init();
     set_prompt('\t');
     
@@ -21,8 +26,11 @@ main(void)
     
     if( setjmp(restart) == 0 )
         printf("FP v0.0\n");
-    else
+    else {
+        vm_reset();
+        obj_arena_close();
         printf("FP restarted\n");
+    }
     yyparse();
     printf("\nFP done\n");
     exit(EXIT_SUCCESS);
@@ -3,9 +3,57 @@
 #include "misc.h"
 #include "obj.h"
 #include "object.hpp"
+#include "list_builder.hpp"
 #include "y.tab.h"
 #include "math_intrinsics.h"
 
+/// The C library function behind a math intrinsic, or null
+static double (*math_func(int tag))(double)
+{
+    switch(tag) {
+        case SIN: return sin;
+        case COS: return cos;
+        case TAN: return tan;
+        case ASIN: return asin;
+        case ACOS: return acos;
+        case ATAN: return atan;
+        case EXP: return exp;
+        case LOG: return log;
+        default: return nullptr;
+    }
+}
+
+    /*
+     * Map a math function over an unboxed vector in one tight loop,
+     *	straight from the packed numbers into a new packed vector.
+     */
+obj_ptr
+vec_math_func(int tag, live_obj_ptr obj)
+{
+    auto fn = math_func(tag);
+    if( !fn || !obj->is_packed() )
+        return(nullptr);
+    const auto n = obj->vec_length();
+    if( n < list_builder::VECTOR_MIN )
+        return(nullptr);
+    const auto store = obj->vec_store();
+    const auto start = obj->vec_offset();
+    auto result = vector_store::create(n, store_kind::DOUBLES);
+    auto out = result->doubles();
+    if( store->kind == store_kind::INTS ){
+        const int *in = store->ints() + start;
+        for( unsigned x = 0; x < n; ++x )
+            out[x] = fn(in[x]);
+    } else {
+        const double *in = store->doubles() + start;
+        for( unsigned x = 0; x < n; ++x )
+            out[x] = fn(in[x]);
+    }
+    result->length = n;
+    obj_unref(obj);
+    return obj_alloc(result, 0, n);
+}
+
 live_obj_ptr
 do_math_func(int tag, live_obj_ptr obj)
 {
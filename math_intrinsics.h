@@ -2,5 +2,7 @@
 #define MATH_INTRINSICS_H
 
 live_obj_ptr do_math_func(int tag, live_obj_ptr obj);
+/// &f of a math function over an unboxed vector, or null if tag isn't one
+obj_ptr vec_math_func(int tag, live_obj_ptr obj);
 
 #endif
@@ -0,0 +1,261 @@
+/*
+ * memo.cpp--remember what user functions gave
+ *
+ *	An FP function always gives the same result for the same argument,
+ *	so after )memo name, the results of name are kept, keyed by their
+ *	arguments, and a call with an argument seen before costs a lookup.
+ *	A recursion which works out the same subproblems over and over
+ *	(fib, say) then does each one once.
+ *
+ *	Each function's cache holds at most MEMO_MAX results; when full,
+ *	the one used least recently goes.  Anything kept is copied out of
+ *	the arena first, since it must outlive the application.  A
+ *	function's cache is emptied when it, or anything it calls, is
+ *	redefined.  The caches are shared by all the threads par.cpp runs,
+ *	under one lock.
+ */
+#include <stdio.h>
+#include <algorithm>
+#include <list>
+#include <mutex>
+#include <string.h>
+#include <unordered_map>
+#include <vector>
+#include "fpcommon.h"
+#include "memo.h"
+#include "list.h"
+#include "obj.h"
+#include "object.hpp"
+#include "symtab.h"
+#include "yystype.h"
+#include "list_iter.hpp"
+#include "symtab_entry.hpp"
+
+    /*
+     * Most results kept for one function.  Override with -DMEMO_MAX=n.
+     */
+#ifndef MEMO_MAX
+#define MEMO_MAX 65536
+#endif
+
+/// One argument, what the function gave for it, and the argument's hash
+struct memo_entry final {
+    live_obj_ptr arg;
+    live_obj_ptr result;
+    unsigned hash;
+};
+
+/// The results kept for one function, the most recently used first
+struct memo_cache final {
+    std::list<memo_entry> lru;
+    std::unordered_multimap<unsigned, std::list<memo_entry>::iterator> index;
+    unsigned long hits = 0;
+    unsigned long misses = 0;
+    unsigned long evictions = 0;
+};
+
+/// The functions whose results are kept, in the order )memo named them
+static std::vector<sym_ptr> memoized;
+
+/// Held while any cache is looked in or added to
+static std::mutex memo_lock;
+
+/// Mix the bits of a number into a hash
+static unsigned
+num_hash(unsigned long long bits)
+{
+    bits ^= bits >> 33;
+    bits *= 0xff51afd7ed558ccdULL;
+    bits ^= bits >> 33;
+    return static_cast<unsigned>(bits);
+}
+
+    /*
+     * Hash of an argument.  Unlike list_hash(), ints and floats hash
+     *	apart; they are different arguments, since a function may well
+     *	give an int for the one and a float for the other.
+     */
+static unsigned
+arg_hash(live_obj_ptr p)
+{
+    switch( p->type() ){
+    case obj_type::T_INT:
+        return num_hash(static_cast<unsigned long long>(p->int_val()));
+    case obj_type::T_FLOAT: {
+        const double d = p->float_val();
+        unsigned long long bits;
+        memcpy(&bits, &d, sizeof(bits));
+        return num_hash(bits) ^ 0x5bd1e995;
+    }
+    case obj_type::T_BOOL:
+        return p->bool_val() ? 1 : 2;
+    case obj_type::T_LIST:
+    case obj_type::T_VECTOR:
+        return list_hash(p) ^ (static_cast<unsigned>(p->list_length()) << 16);
+    case obj_type::T_UNDEF:
+        break;
+    }
+    return(3);
+}
+
+/// Tell if p and q are the same argument, telling ints from floats
+static bool
+same_arg(live_obj_ptr p, live_obj_ptr q)
+{
+    if( p == q )
+        return(true);
+    if( p->is_list() && q->is_list() ){
+        if( p->list_length() != q->list_length() )
+            return(false);
+        if( p->is_packed() && q->is_packed() &&
+            p->vec_store()->kind == q->vec_store()->kind ){
+            auto s1 = p->vec_store();
+            auto s2 = q->vec_store();
+            const auto x1 = p->vec_offset();
+            const auto x2 = q->vec_offset();
+            const auto n = p->vec_length();
+            if( s1->kind == store_kind::INTS )
+                return std::equal(s1->ints() + x1, s1->ints() + x1 + n, s2->ints() + x2);
+            return std::equal(s1->doubles() + x1, s1->doubles() + x1 + n, s2->doubles() + x2);
+        }
+        list_iter i1{p};
+        list_iter i2{q};
+        for( ; !i1.done(); i1.next(), i2.next() ){
+            if( !same_arg(i1.elem(), i2.elem()) )
+                return(false);
+        }
+        return(true);
+    }
+    if( p->type() != q->type() )
+        return(false);
+    switch( p->type() ){
+    case obj_type::T_INT:
+        return( p->int_val() == q->int_val() );
+    case obj_type::T_FLOAT:
+        return( p->float_val() == q->float_val() );
+    case obj_type::T_BOOL:
+        return( p->bool_val() == q->bool_val() );
+    default:
+        return(false);
+    }
+}
+
+/// Drop everything in a cache
+static void
+empty(memo_cache &cache)
+{
+    for( auto &e: cache.lru ){
+        obj_unref(e.arg);
+        obj_unref(e.result);
+    }
+    cache.lru.clear();
+    cache.index.clear();
+}
+
+obj_ptr
+memo_lookup(live_sym_ptr def, live_obj_ptr obj)
+{
+    auto cache = def->sym_memo;
+    assert(cache);
+    const auto hash = arg_hash(obj);
+    std::lock_guard<std::mutex> hold{memo_lock};
+    auto range = cache->index.equal_range(hash);
+    for( auto it = range.first; it != range.second; ++it ){
+        auto e = it->second;
+        if( !same_arg(e->arg, obj) )
+            continue;
+        cache->hits++;
+        cache->lru.splice(cache->lru.begin(), cache->lru, e);
+        e->result->inc_ref();
+        return(e->result);
+    }
+    cache->misses++;
+    return(nullptr);
+}
+
+void
+memo_store(live_sym_ptr def, live_obj_ptr obj, live_obj_ptr result)
+{
+    auto cache = def->sym_memo;
+    assert(cache);
+
+	// ? may just mean the recursion went too deep this time
+    if( obj->is_undef() || result->is_undef() )
+        return;
+
+    const auto hash = arg_hash(obj);
+    std::lock_guard<std::mutex> hold{memo_lock};
+
+	// Another thread may have worked it out meanwhile
+    auto kept = cache->index.equal_range(hash);
+    for( auto it = kept.first; it != kept.second; ++it ){
+        if( same_arg(it->second->arg, obj) )
+            return;
+    }
+
+    if( cache->lru.size() >= MEMO_MAX ){
+        auto &last = cache->lru.back();
+        auto range = cache->index.equal_range(last.hash);
+        for( auto it = range.first; it != range.second; ++it ){
+            if( &*it->second == &last ){
+                cache->index.erase(it);
+                break;
+            }
+        }
+        obj_unref(last.arg);
+        obj_unref(last.result);
+        cache->lru.pop_back();
+        cache->evictions++;
+    }
+    cache->lru.push_front({obj_keep(obj), obj_keep(result), hash});
+    cache->index.emplace(hash, cache->lru.begin());
+}
+
+void
+memo_flush(live_sym_ptr def)
+{
+    if( def->sym_memo )
+        empty(*def->sym_memo);
+}
+
+void
+memo_toggle(const char * _Nonnull name)
+{
+    auto def = lookup(name);
+    if( def->is_builtin() ){
+        printf("%s: not a user function\n", name);
+        return;
+    }
+    if( def->sym_memo ){
+        empty(*def->sym_memo);
+        delete def->sym_memo;
+        def->sym_memo = nullptr;
+        memoized.erase(std::find(memoized.begin(), memoized.end(), def));
+        printf("Not keeping the results of %s\n", name);
+        def->invalidate_users();
+        return;
+    }
+    if( !def->is_defined() ){
+        printf("%s: undefined\n", name);
+        return;
+    }
+    def->sym_memo = new memo_cache;
+    memoized.push_back(def);
+    def->invalidate_users();
+    printf("Keeping the results of %s\n", name);
+}
+
+void
+memo_stats(void)
+{
+    if( memoized.empty() ){
+        printf("No function's results are being kept\n");
+        return;
+    }
+    for( auto def: memoized ){
+        auto cache = def->sym_memo;
+        printf("%s: %zu kept, %lu hits, %lu misses, %lu evicted\n",
+               def->sym_pname.c_str(), cache->lru.size(),
+               cache->hits, cache->misses, cache->evictions);
+    }
+}
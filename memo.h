@@ -0,0 +1,16 @@
+#ifndef MEMO_H
+#define MEMO_H
+
+//memo.cpp
+/// memo_toggle()--switch caching of the results of the function name on or off
+void memo_toggle(const char * _Nonnull name);
+/// memo_stats()--show how the cache of each function doing it is faring
+void memo_stats(void);
+/// memo_lookup()--referenced result cached for def applied to obj, or null
+obj_ptr memo_lookup(live_sym_ptr def, live_obj_ptr obj);
+/// memo_store()--remember what def gave for obj; both stay the caller's
+void memo_store(live_sym_ptr def, live_obj_ptr obj, live_obj_ptr result);
+/// memo_flush()--forget what def has given, if it caches anything
+void memo_flush(live_sym_ptr def);
+
+#endif
@@ -4,61 +4,451 @@
  *	Copyright (c) 1986 by Andy Valencia
  */
 #include <stdio.h>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <vector>
 #include "fpcommon.h"
+#include "bump_arena.hpp"
 #include "obj.h"
 #include "object.hpp"
+#include "list_builder.hpp"
+#include "list_iter.hpp"
+#include "reclaim.h"
+#include "slab_pool.hpp"
+
+using cell_pool = slab_pool<sizeof(object)>;
+
+/// Where all object cells come from
+static cell_pool cells;
+
+    /*
+     * Cells freed on the reclaim thread can't go straight back to the
+     *	pool, which belongs to the main thread.  They are gathered into
+     *	chains of RETURN_BATCH and pushed on a lock-free stack, which
+     *	obj_cell() takes over whenever the pool runs dry.
+     */
+static constexpr size_t RETURN_BATCH = 4096;
+
+/// A chain of cells on its way back from the reclaim thread
+struct returned_cells {
+    cell_pool::chain chain;
+    returned_cells * _Nullable next;
+};
+static std::atomic<returned_cells *> returned{nullptr};
+
+/// On the reclaim thread, the chain freed cells go to instead of the pool
+static thread_local cell_pool::chain * _Nullable away = nullptr;
+
+    /*
+     * While par.cpp has other threads applying functions, any of them
+     *	may make and free objects.  Each thread then goes through a cache
+     *	of cells of its own, which it fills from the pool, and empties
+     *	into it, CACHE_BATCH cells at a time under pool_lock.  The caches
+     *	all go back to the pool when the threads are done.
+     */
+static constexpr size_t CACHE_BATCH = 1024;
+
+/// Cells are going through the threads' caches
+static bool sharing = false;
+/// Held while a thread's cache is filled or emptied
+static std::mutex pool_lock;
+/// Every thread's cache, for obj_share() to empty
+static std::vector<cell_pool::chain *> caches;
+/// This thread's cache, once it has one
+static thread_local cell_pool::chain * _Nullable cache = nullptr;
+
+    /*
+     * Under )arena, each top-level application gets its objects and
+     *	stores from an arena.  Freeing one of them does nothing; the whole
+     *	arena is reset when the application is done with, or abandoned by
+     *	an error or interrupt.  Nothing made during an application can
+     *	outlive it: definitions are never made while one is running.
+     */
+static bump_arena<> arena;
+/// )arena is on
+static bool arena_wanted = false;
+/// An application is running in the arena
+static bool arena_open = false;
+
+    /*
+     * Range of integers which are interned, along with T, F, ? and <>.
+     *	Override with -DSMALLINT_MIN=n -DSMALLINT_MAX=n.
+     */
+#ifndef SMALLINT_MIN
+#define SMALLINT_MIN (-128)
+#endif
+#ifndef SMALLINT_MAX
+#define SMALLINT_MAX 1023
+#endif
+static constexpr int small_min = SMALLINT_MIN;
+static constexpr int small_max = SMALLINT_MAX;
+static_assert(small_min <= small_max, "empty SMALLINT range");
+
+/// The interned objects, built by obj_init()
+static obj_ptr obj_true, obj_false, obj_undef, obj_nil;
+static obj_ptr small_ints[small_max - small_min + 1];
 
 #ifdef MEMSTAT
 int obj_out = 0;
-static void incobjcount(void) { obj_out++;}
-static void decobjcount(void) { obj_out--;}
+/// Arena objects not yet dropped, which a reset gets rid of
+static size_t arena_out = 0;
+static void incobjcount(void) { __atomic_add_fetch(&obj_out, 1, __ATOMIC_RELAXED);}
+static void decobjcount(size_t n = 1) { __atomic_sub_fetch(&obj_out, static_cast<int>(n), __ATOMIC_RELAXED);}
+static void incarenacount(void) { arena_out++;}
+static void decarenacount(void) { arena_out--;}
+static void resetarenacount(void) { decobjcount(arena_out); arena_out = 0;}
+
+/// Report how full the object slabs are
+void
+obj_memstat(void)
+{
+    obj_reclaim_wait();
+    printf("%d objects out, %zu of %zu cells in use in %zu slabs\n",
+	obj_out, cells.cells_in_use(), cells.capacity(), cells.slabs());
+}
 #else
 static void incobjcount(void) {}
-static void decobjcount(void) {}
+static void decobjcount(size_t = 1) {}
+static void incarenacount(void) {}
+static void decarenacount(void) {}
+static void resetarenacount(void) {}
 #endif
 
+/// Put the cells sent back by the reclaim thread into the pool
+static void
+take_back(void)
+{
+    if( !returned.load(std::memory_order_relaxed) )
+        return;
+    auto r = returned.exchange(nullptr, std::memory_order_acquire);
+    while( r ){
+        decobjcount(r->chain.count);
+        cells.release(r->chain);
+        auto next = r->next;
+        delete r;
+        r = next;
+    }
+}
+
+/// Send a chain of cells freed on the reclaim thread back to the pool
+static void
+hand_back(cell_pool::chain &chain)
+{
+    if( !chain.head )
+        return;
+    auto r = new returned_cells{chain, returned.load(std::memory_order_relaxed)};
+    chain = cell_pool::chain{};
+    while( !returned.compare_exchange_weak(r->next, r,
+                std::memory_order_release, std::memory_order_relaxed) )
+        ;
+}
+
+/// A cell from this thread's cache, topping it up from the pool if need be
+static void * _Nonnull
+cache_alloc(void)
+{
+    auto c = cache;
+    if( !c->head ){
+        std::lock_guard<std::mutex> hold{pool_lock};
+        if( !cells.has_free() )
+            take_back();
+        *c = cells.alloc(CACHE_BATCH);
+    }
+    return c->pop();
+}
+
+/// Put a cell in this thread's cache, sending the lot back if it's full
+static void
+cache_free(void * _Nonnull p)
+{
+    auto c = cache;
+    c->add(p);
+    if( c->count >= 2 * CACHE_BATCH ){
+        std::lock_guard<std::mutex> hold{pool_lock};
+        cells.release(*c);
+    }
+}
+
+/// Build an object in a fresh cell, from the arena if one is open
+template <typename... ARGS>
+static live_obj_ptr
+obj_make(ARGS... args)
+{
+    incobjcount();
+    if( arena_open ){
+        auto p = new (arena.alloc(sizeof(object))) object{args...};
+        p->mark_arena();
+        incarenacount();
+        return p;
+    }
+    if( sharing )
+        return new (cache_alloc()) object{args...};
+    if( !cells.has_free() )
+        take_back();
+    return new (cells.alloc()) object{args...};
+}
+
+/// Build an immortal object in a cell which MEMSTAT doesn't count
+template <typename T>
+static live_obj_ptr
+obj_intern(T value)
+{
+    auto p = new (cells.alloc()) object{value};
+    p->make_immortal();
+    return p;
+}
+
+/// Set up the interned objects; call once before any obj_alloc()
+void
+obj_init(void)
+{
+    obj_true = obj_intern(true);
+    obj_false = obj_intern(false);
+    obj_nil = obj_intern<obj_ptr>(nullptr);
+    obj_undef = object::undefined(cells.alloc());
+    obj_undef->make_immortal();
+    for( int x = small_min; x <= small_max; ++x )
+        small_ints[x - small_min] = obj_intern(x);
+}
+
 live_obj_ptr
 obj_alloc(int value)
 {
-    incobjcount();
-    return new object{value};
+    if( (value >= small_min) && (value <= small_max) ){
+        auto p = small_ints[value - small_min];
+        assert(p);
+        return p;
+    }
+    return obj_make(value);
 }
 
 live_obj_ptr
 obj_alloc(bool value)
 {
-    incobjcount();
-    return new object{value};
+    auto p = value ? obj_true : obj_false;
+    assert(p);
+    return p;
 }
 
 live_obj_ptr
 obj_alloc(double value)
 {
-    incobjcount();
-    return new object{value};
+    return obj_make(value);
 }
 
 live_obj_ptr
 obj_alloc(obj_ptr car_, obj_ptr cdr_)
 {
-    incobjcount();
-    return new object{car_, cdr_};
+    if( !car_ ){
+        assert(!cdr_);
+        assert(obj_nil);
+        return obj_nil;
+    }
+    return obj_make(car_, cdr_);
+}
+
+live_obj_ptr
+obj_alloc(vector_store * _Nonnull store, unsigned offset, unsigned length)
+{
+    return obj_make(store, offset, length);
+}
+
+obj_ptr
+vector_store::box(unsigned x)
+{
+    assert(is_packed());
+    assert(x < length);
+    if( is_range() )
+        fill();
+    auto b = __atomic_load_n(&boxes, __ATOMIC_ACQUIRE);
+    if( !b ){
+        make_boxes();
+        b = __atomic_load_n(&boxes, __ATOMIC_ACQUIRE);
+    }
+    if( auto p = __atomic_load_n(&b[x], __ATOMIC_ACQUIRE) )
+        return(p);
+
+	// A box lives as long as its store, so it can't be in the arena
+	// unless the store is
+    const bool was_open = arena_open;
+    if( was_open )
+        arena_open = in_arena;
+    live_obj_ptr p;
+    if( kind == store_kind::INTS )
+        p = obj_alloc(ints()[x]);
+    else
+        p = obj_alloc(doubles()[x]);
+    if( was_open )
+        arena_open = true;
+
+	// Another thread may have boxed it first
+    obj_ptr none = nullptr;
+    if( !__atomic_compare_exchange_n(&b[x], &none, p, false,
+                                     __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE) ){
+        obj_unref(p);
+        return(none);
+    }
+    return(p);
+}
+
+/// Held while a range is written out, in case two threads want it at once
+static std::mutex fill_lock;
+
+void
+vector_store::fill()
+{
+    std::lock_guard<std::mutex> hold{fill_lock};
+    if( !is_range() )
+        return;
+    auto slots = ints();
+    for( unsigned x = 0; x < length; ++x )
+        slots[x] = static_cast<int>(x + 1);
+    __atomic_store_n(&range, false, __ATOMIC_RELEASE);
+}
+
+void
+vector_store::make_boxes()
+{
+    obj_ptr *fresh;
+    if( in_arena )
+        fresh = static_cast<obj_ptr *>(arena.alloc(capacity * sizeof(obj_ptr)));
+    else
+        fresh = new obj_ptr[capacity];
+    std::fill(fresh, fresh + capacity, nullptr);
+
+	// Or use the one another thread just made
+    obj_ptr *none = nullptr;
+    if( !__atomic_compare_exchange_n(&boxes, &none, fresh, false,
+                                     __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE) && !in_arena )
+        delete[] fresh;
+}
+
+void *
+vector_store::block(size_t bytes, bool &in_arena)
+{
+    in_arena = arena_open;
+    if( arena_open )
+        return arena.alloc(bytes);
+    return ::operator new(bytes);
 }
 
 live_obj_ptr undefined(void)
 {
-    incobjcount();
-    auto obj = object::undefined();
-    return(obj);
+    assert(obj_undef);
+    return obj_undef;
 }
 
-/// Free an object
+/// Free an object, returning its cell to the pool
 static void
 obj_free(obj_ptr p)
 {
     assert(p);
+    const bool in_arena = p->in_arena();
+    p->~object();
+    if( in_arena ){
+        decobjcount();
+        decarenacount();
+        return;
+    }
+    if( away ){
+        away->add(p);
+        if( away->count >= RETURN_BATCH )
+            hand_back(*away);
+        return;
+    }
     decobjcount();
-    delete p;
+    if( sharing )
+        cache_free(p);
+    else
+        cells.release(p);
+}
+
+/// Deal with a store whose last view is gone
+static void
+bury(vector_store * _Nonnull store, vector_store * _Nullable &dead_stores)
+{
+	// A big one may be left to the reclaim thread
+    if( !away && !arena_open && reclaim_store(store) )
+	return;
+    if( !store->is_packed() ){
+	store->next_dead = dead_stores;
+	dead_stores = store;
+	return;
+    }
+	// Boxes are only ever numbers, so this doesn't nest
+    if( store->boxes ){
+	for( unsigned x = 0; x < store->length; ++x )
+	    obj_unref( store->boxes[x] );
+    }
+    vector_store::destroy(store);
+}
+
+    /*
+     * Drop a reference to p, and then empty out the stores on dead_stores.
+     *
+     * This runs in constant C stack, however long or deep the structure.
+     *	A dead cons cell goes on to its cdr straight away, and is itself
+     *	kept (linked through its cdr) until we come back for its car.
+     *	A dead store of objects is kept the same way, with its refs
+     *	field, no longer needed, counting off the slots already dropped.
+     */
+static void
+drop(obj_ptr p, vector_store * _Nullable dead_stores)
+{
+    obj_ptr dead_cells = nullptr;
+
+    for(;;){
+	if( p && !p->dec_ref() ){
+	    switch( p->type() ){
+	    case obj_type::T_INT:
+	    case obj_type::T_FLOAT:
+	    case obj_type::T_UNDEF:
+	    case obj_type::T_BOOL:
+		obj_free(p);
+		break;
+	    case obj_type::T_LIST: {
+		auto next = p->cdr();
+		if( p->car() ){
+		    p->cdr(dead_cells);
+		    dead_cells = p;
+		} else
+		    obj_free(p);
+		p = next;
+		continue;
+	    }
+	    case obj_type::T_VECTOR: {
+		auto store = p->vec_store_as_is();
+		obj_free(p);
+		if( store->drop_ref() )
+		    bury(store, dead_stores);
+		break;
+	    }
+	    }
+	}
+
+	    // Done with p; find the next thing to drop
+	if( dead_stores ){
+	    auto store = dead_stores;
+	    if( store->refs < store->length ){
+		p = store->elems()[store->refs++];
+		continue;
+	    }
+	    dead_stores = store->next_dead;
+	    store->boxes = nullptr;
+	    vector_store::destroy(store);
+	    p = nullptr;
+	    continue;
+	}
+	if( dead_cells ){
+	    auto cell = dead_cells;
+	    dead_cells = cell->cdr();
+	    p = cell->car();
+	    obj_free(cell);
+	    continue;
+	}
+	return;
+    }
 }
 
     /*
@@ -68,24 +458,157 @@ obj_free(obj_ptr p)
 void
 obj_unref(obj_ptr p)
 {
-    if( !p ) return;
-    if( p->dec_ref() ) return;
+    drop(p, nullptr);
+}
+
+void
+obj_reclaim(vector_store * _Nonnull store)
+{
+    cell_pool::chain chain;
+    away = &chain;
+    vector_store *dead_stores = nullptr;
+    bury(store, dead_stores);
+    drop(nullptr, dead_stores);
+    away = nullptr;
+    hand_back(chain);
+}
+
+void
+obj_reclaim_wait(void)
+{
+    reclaim_drain();
+    take_back();
+}
+
+void
+obj_thread(void)
+{
+    cache = new cell_pool::chain;
+    std::lock_guard<std::mutex> hold{pool_lock};
+    caches.push_back(cache);
+}
+
+void
+obj_share(bool on)
+{
+    if( on && !cache )
+        obj_thread();
+    if( !on ){
+        for( auto c: caches )
+            cells.release(*c);
+    }
+    sharing = on;
+}
+
+bool
+obj_in_arena(void)
+{
+    return(arena_open);
+}
+
+void
+obj_arena_toggle(void)
+{
+    arena_wanted = !arena_wanted;
+    printf("Arena allocation for applications %s\n", arena_wanted ? "on" : "off");
+}
+
+void
+obj_arena_open(void)
+{
+    obj_arena_close();
+    arena_open = arena_wanted;
+}
+
+void
+obj_arena_close(void)
+{
+    if( !arena_open )
+        return;
+    arena_open = false;
+    resetarenacount();
+    arena.reset();
+}
+
+    /*
+     * Copy an object in the arena, element by element, to the heap; what
+     *	is on the heap already is shared.  Only the top cell need be
+     *	checked, since nothing on the heap can hold a cell in the arena.
+     */
+static live_obj_ptr
+heap_copy(live_obj_ptr p)
+{
+    if( !p->in_arena() ){
+        p->inc_ref();
+        return(p);
+    }
     switch( p->type() ){
     case obj_type::T_INT:
+        return obj_alloc(p->int_val());
     case obj_type::T_FLOAT:
-    case obj_type::T_UNDEF:
+        return obj_alloc(p->float_val());
     case obj_type::T_BOOL:
-	obj_free(p);
-	return;
+    case obj_type::T_UNDEF:
+        break;
     case obj_type::T_LIST:
-	obj_unref( p->car() );
-	obj_unref( p->cdr() );
-	obj_free(p);
-	return;
+    case obj_type::T_VECTOR: {
+        if( p->is_range() ){
+            auto store = vector_store::create_range(p->vec_offset() + p->vec_length());
+            return obj_alloc(store, p->vec_offset(), p->vec_length());
+        }
+        list_builder b{static_cast<unsigned>(p->list_length())};
+        if( p->is_packed() ){
+            auto store = p->vec_store();
+            const auto start = p->vec_offset();
+            const auto end = start + p->vec_length();
+            for( auto x = start; x < end; ++x ){
+                if( store->kind == store_kind::INTS )
+                    b.push(store->ints()[x]);
+                else
+                    b.push(store->doubles()[x]);
+            }
+        } else {
+            for( list_iter it{p}; !it.done(); it.next() )
+                b.push(heap_copy(it.elem()));
+        }
+        return(b.finish());
+    }
+    }
+    p->inc_ref();
+    return(p);
+}
+
+live_obj_ptr
+obj_keep(live_obj_ptr p)
+{
+	// Leave arena_open alone when it's off; other threads may be reading it
+    if( !arena_open ){
+        p->inc_ref();
+        return(p);
     }
+    arena_open = false;
+    auto q = heap_copy(p);
+    arena_open = true;
+    return(q);
 }
 
 static char last_close = 0;
+
+/// Print the elements of an unboxed vector without boxing them
+static void
+prpacked(obj_ptr p)
+{
+    auto store = p->vec_store();
+    const auto start = p->vec_offset();
+    const auto end = start + p->vec_length();
+    for( auto x = start; x < end; ++x ){
+	if( store->kind == store_kind::INTS )
+	    printf("%d ",store->ints()[x]);
+	else
+	    printf("%.9g ",store->doubles()[x]);
+    }
+    last_close = 0;
+}
 void
 obj_prtree(obj_ptr p)
 {
@@ -109,17 +632,18 @@ obj_prtree(obj_ptr p)
 	printf("? ");
     return;
     case obj_type::T_LIST:
+    case obj_type::T_VECTOR:
 	printf("<");
 	last_close = 0;
-	if( !p->car() ){
+	if( p->is_nil() ){
 	    printf(">");
 	    last_close = 1;
 	    return;
 	}
-	while( p ){
-	    obj_prtree( p->car() );
-	    p = p->cdr();
-	}
+	if( p->is_packed() )
+	    prpacked(p);
+	else for( list_iter it{p}; !it.done(); it.next() )
+	    obj_prtree( it.elem() );
 	if( !last_close ) putchar('\b');
 	printf("> ");
 	last_close = 1;
@@ -1,7 +1,11 @@
 #ifndef OBJ_H
 #define OBJ_H
 
+struct vector_store;
+
 //obj.c
+/// sets up the interned T, F, ?, <> and small integers
+void obj_init(void);
 /// constructs a T_INT
 live_obj_ptr obj_alloc(int value);
 /// constructs a T_BOOL
@@ -10,9 +14,32 @@ live_obj_ptr obj_alloc(bool value);
 live_obj_ptr obj_alloc(double value);
 /// constructs a T_LIST
 live_obj_ptr obj_alloc(obj_ptr car_, obj_ptr cdr_ = nullptr);
+/// constructs a T_VECTOR viewing part of store, taking over one store ref
+live_obj_ptr obj_alloc(vector_store * _Nonnull store, unsigned offset, unsigned length);
 ///generates the undefined object & returns it
 live_obj_ptr undefined(void);
 void obj_prtree(obj_ptr p);
 void obj_unref(obj_ptr p);
+/// on the reclaim thread, drop the contents of a store whose last view is gone
+void obj_reclaim(vector_store * _Nonnull store);
+/// wait for the reclaim thread to catch up, and take back the cells it freed
+void obj_reclaim_wait(void);
+/// set up a cache of cells for the calling thread, to be used while sharing
+void obj_thread(void);
+/// switch on or off letting every thread make and free objects; no other thread may be busy
+void obj_share(bool on);
+/// true while an application runs in an arena
+bool obj_in_arena(void);
+/// switch arena allocation for top-level applications on or off
+void obj_arena_toggle(void);
+/// start an application, in a fresh arena if they are on
+void obj_arena_open(void);
+/// done with an application, finished or not; drop its arena in one go
+void obj_arena_close(void);
+/// referenced p, or a copy of it on the heap if it is in the arena, to outlive it
+live_obj_ptr obj_keep(live_obj_ptr p);
+#ifdef MEMSTAT
+void obj_memstat(void);
+#endif
 
 #endif
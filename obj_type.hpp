@@ -2,7 +2,7 @@
 #define OBJ_TYPE_HPP
 
 /// The symbolic names for the different types
-enum class obj_type {
+enum class obj_type : unsigned char {
     /// Integer
     T_INT = 1,
     /// Floating point
@@ -12,7 +12,9 @@ enum class obj_type {
     /// The undefined object
     T_UNDEF = 4,
     /// A boolean value
-    T_BOOL = 5
+    T_BOOL = 5,
+    /// A list kept in an array
+    T_VECTOR = 6
 };
 
 #endif
@@ -1,3 +1,4 @@
+#include <new>
 #include "fpcommon.h"
 #include "object.hpp"
 
@@ -5,13 +6,7 @@ bool object::is_pair() const
 {
     if( !is_list() )
         return(false);
-    if( car() == nullptr )
-        return(false);
-    if( cdr() == nullptr )
-        return(false);
-    if( cdr()->cdr() )
-        return(false);
-    return(true);
+    return( at_least(2) && !at_least(3) );
 }
 
 /// list_length()--return length of a list
@@ -20,14 +15,35 @@ int object::list_length() const
     auto p = this;
     int l = 0;
     
-    while( p && p->car() ){
+    while( p && p->is_cons() && p->car() ){
         ++l;
         p = p->cdr();
     }
+    // A chain may end in a vector, whose length we just know
+    if( p && p->is_vector() )
+        l += static_cast<int>(p->vec_length());
     return(l);
 }
 
-live_obj_ptr object::undefined()
+/// at_least()--tell if a list has n or more elements, looking no further
+bool object::at_least(int n) const
+{
+    auto p = this;
+    
+    while( n > 0 ){
+        if( !p )
+            return(false);
+        if( p->is_vector() )
+            return( static_cast<int>(p->vec_length()) >= n );
+        if( !p->car() )
+            return(false);
+        --n;
+        p = p->cdr();
+    }
+    return(true);
+}
+
+live_obj_ptr object::undefined(void * _Nonnull where)
 {
-    return new object{obj_type::T_UNDEF, 0, 0.0};
+    return new (where) object{obj_type::T_UNDEF};
 }
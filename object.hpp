@@ -2,106 +2,158 @@
 #define OBJECT_HPP
 
 #include "obj_type.hpp"
+#include "refcount.hpp"
+#include "vector_store.hpp"
 
-/// An object's structure
+/// The two halves of a cons cell
+struct cons_cell {
+    /// Head of list
+    obj_ptr car_;
+    /// and Tail
+    obj_ptr cdr_;
+};
+
+/// A T_VECTOR list: a slice of a shared vector_store
+struct vector_view {
+    vector_store * _Nonnull store;
+    /// First slot of the store which belongs to us
+    unsigned offset;
+    /// Number of elements, never zero
+    unsigned length;
+};
+
+/**
+ * An object's structure.  A cell is only ever a scalar, a cons or a
+ *	vector view, so the payload is a union selected by o_type; a cons
+ *	is just its two pointers plus the type/refcount word.
+ *
+ * A list is the empty list (a T_LIST whose car is null), a chain of
+ *	T_LIST cells, or a T_VECTOR.  The cdr of the last cell of a chain
+ *	may itself be a T_VECTOR, so code walking a list should use a
+ *	list_iter rather than following cdr() itself.
+ */
 struct object final {
 private:
     /// Type for selecting
     const obj_type o_type;
-    /// Number of current refs, for GC
+    /// Made in an application's arena, so never freed on its own
+    bool o_arena = false;
+    /// Cached list_hash() of a list, 0 until it is first asked for
+    unsigned short o_hash = 0;
+    /// Number of current refs, for GC; IMMORTAL for interned objects
     unsigned o_refs = 1;
-    /// T_INT, T_BOOL
-    int o_int = 0;
-    /// T_FLOAT
-    const double o_double;
-    /// Head of list
-    obj_ptr car_ = nullptr;
-    /// and Tail
-    obj_ptr cdr_ = nullptr;
+    union {
+        /// T_INT, T_BOOL
+        int o_int;
+        /// T_FLOAT
+        double o_double;
+        /// T_LIST
+        cons_cell o_cons;
+        /// T_VECTOR
+        vector_view o_vec;
+    };
 
-    ///primary constructor, all others call this
-    explicit object(obj_type type, int value, double float_val, obj_ptr car_in=nullptr, obj_ptr cdr_in=nullptr)
+    /// only for the undefined object, which has no payload
+    explicit object(obj_type type)
     : o_type{type},
-    o_int{value},
-    o_double{float_val},
-    car_{car_in},
-    cdr_{cdr_in}
+    o_int{0}
     {
     }
     
 public:
     
     explicit object(int value)
-    : object(obj_type::T_INT, value, 0.0)
+    : o_type{obj_type::T_INT},
+    o_int{value}
     {
     }
     
     explicit object(bool value)
-    : object(obj_type::T_BOOL, value, 0.0)
+    : o_type{obj_type::T_BOOL},
+    o_int{value}
     {
     }
     
     explicit object(double value)
-    : object(obj_type::T_FLOAT, 0, value)
+    : o_type{obj_type::T_FLOAT},
+    o_double{value}
     {
     }
     
     explicit object(obj_ptr car_in)
-    : object(obj_type::T_LIST, 0, 0, car_in, nullptr)
+    : object(car_in, nullptr)
     {
     }
     
     explicit object(obj_ptr car_in, obj_ptr cdr_in)
-    : object(obj_type::T_LIST, 0, 0, car_in, cdr_in)
+    : o_type{obj_type::T_LIST},
+    o_cons{car_in, cdr_in}
+    {
+    }
+    
+    /// a view of length elements of store, starting at offset
+    explicit object(vector_store * _Nonnull store, unsigned offset, unsigned length)
+    : o_type{obj_type::T_VECTOR},
+    o_vec{store, offset, length}
     {
+        assert(length > 0);
+        assert(offset + length <= store->length);
     }
     
     ///CAR manipulates the object as a list & gives its first part
     obj_ptr car()
     {
-        assert(is_list());
-        return car_;
+        if( is_vector() )
+            return vec_elem(0);
+        assert(is_cons());
+        return o_cons.car_;
     }
 
 private:
     obj_ptr car() const
     {
-        assert(is_list());
-        return car_;
+        if( is_vector() )
+            return vec_elem(0);
+        assert(is_cons());
+        return o_cons.car_;
     }
 
 public:
     void car(obj_ptr ptr)
     {
-        assert(is_list());
-        car_ = ptr;
+        assert(is_cons());
+        assert(!is_immortal());
+        o_cons.car_ = ptr;
     }
     
-    ///CDR is like CAR but gives all but the first
+    ///CDR is like CAR but gives all but the first; only for T_LIST
     obj_ptr cdr()
     {
-        assert(is_list());
-        return cdr_;
+        assert(is_cons());
+        return o_cons.cdr_;
     }
 
 private:
     obj_ptr cdr() const
     {
-        assert(is_list());
-        return cdr_;
+        assert(is_cons());
+        return o_cons.cdr_;
     }
 
 public:
     void cdr(obj_ptr ptr)
     {
-        assert(is_list());
-        cdr_ = ptr;
+        assert(is_cons());
+        assert(!is_immortal());
+        o_cons.cdr_ = ptr;
     }
     
     ///(car (cdr x))
     obj_ptr cadr()
     {
-        assert(is_list());
+        if( is_vector() )
+            return vec_elem(1);
+        assert(is_cons());
         assert(cdr());
         return cdr()->car();
     }
@@ -110,7 +162,9 @@ private:
     ///(car (cdr x))
     obj_ptr cadr() const
     {
-        assert(is_list());
+        if( is_vector() )
+            return vec_elem(1);
+        assert(is_cons());
         assert(cdr());
         return cdr()->car();
     }
@@ -120,25 +174,147 @@ public:
     {
         //TODO change annotation
         assert(ptr);
-        assert(is_list());
+        assert(is_cons());
         assert(cdr());
         cdr()->car(ptr);
     }
     
     obj_ptr *cdr_addr()
     {
-        return &cdr_;
+        assert(is_cons());
+        assert(!is_immortal());
+        return &o_cons.cdr_;
+    }
+    
+    /// The store behind a T_VECTOR, with a range's ints written out
+    vector_store * _Nonnull vec_store() const
+    {
+        assert(is_vector());
+        if( o_vec.store->is_range() )
+            o_vec.store->fill();
+        return o_vec.store;
+    }
+    
+    /// The store behind a T_VECTOR as it is, for taking or dropping a view of it
+    vector_store * _Nonnull vec_store_as_is() const
+    {
+        assert(is_vector());
+        return o_vec.store;
+    }
+    
+    /// Where a T_VECTOR starts in its store
+    unsigned vec_offset() const
+    {
+        assert(is_vector());
+        return o_vec.offset;
+    }
+    
+    /// Point a T_VECTOR somewhere else, for in-place updates
+    void vec_reseat(vector_store * _Nonnull store, unsigned offset, unsigned length)
+    {
+        assert(is_vector());
+        assert(length > 0);
+        assert(offset + length <= store->length);
+        o_vec = vector_view{store, offset, length};
+        o_hash = 0;
+    }
+    
+    /// Element count of a T_VECTOR, in O(1)
+    unsigned vec_length() const
+    {
+        assert(is_vector());
+        return o_vec.length;
+    }
+    
+    /// Element x of a T_VECTOR, not referenced for the caller
+    obj_ptr vec_elem(unsigned x) const
+    {
+        assert(is_vector());
+        assert(x < o_vec.length);
+        return o_vec.store->elem(o_vec.offset + x);
+    }
+    
+    /// true for a T_VECTOR whose store holds unboxed numbers
+    bool is_packed() const
+    {
+        return is_vector() && o_vec.store->is_packed();
+    }
+    
+    /// true for a T_VECTOR slice of an iota range not yet written out
+    bool is_range() const
+    {
+        return is_vector() && o_vec.store->is_range();
     }
     
+    /// Element x of a range, worked out from where it is
+    int range_elem(unsigned x) const
+    {
+        assert(x < o_vec.length);
+        return static_cast<int>(o_vec.offset + x + 1);
+    }
+    
+    /// The cached hash of a list, or 0 if it hasn't been worked out
+    unsigned short cached_hash() const
+    {
+        return __atomic_load_n(&o_hash, __ATOMIC_RELAXED);
+    }
+    
+    void cache_hash(unsigned short hash)
+    {
+        assert(is_list());
+        assert(hash != 0);
+	    // Threads sharing the list may race to store the same hash
+        __atomic_store_n(&o_hash, hash, __ATOMIC_RELAXED);
+    }
+    
+    /// The list has been changed in place, so its hash must be redone
+    void forget_hash()
+    {
+        o_hash = 0;
+    }
+    
+    /// Refcount of an interned object, which is never freed
+    static constexpr unsigned IMMORTAL = ~0U;
+    
     void inc_ref()
     {
-        o_refs++;
+        if( ref_get(o_refs) != IMMORTAL )
+            ref_inc(o_refs);
     }
     
     bool dec_ref()
     {
-        o_refs--;
-        return o_refs >0;
+        if( ref_get(o_refs) == IMMORTAL )
+            return true;
+        return ref_dec(o_refs) > 0;
+    }
+    
+    /// true if whoever holds this reference holds the only one
+    bool is_unique() const
+    {
+        return ref_get(o_refs) == 1;
+    }
+    
+    bool is_immortal() const
+    {
+        return ref_get(o_refs) == IMMORTAL;
+    }
+    
+    bool in_arena() const
+    {
+        return o_arena;
+    }
+    
+    /// Note that the cell came from the arena
+    void mark_arena()
+    {
+        o_arena = true;
+    }
+    
+    /// Pin an object for the life of the program
+    void make_immortal()
+    {
+        o_refs = IMMORTAL;
     }
     
     bool is_bool() const
@@ -167,11 +343,29 @@ public:
         return type() == obj_type::T_FLOAT;
     }
     
+    /// true for any list, whichever way it is stored
     bool is_list() const
+    {
+        return is_cons() || is_vector();
+    }
+    
+    /// true for a cons cell (including the empty list)
+    bool is_cons() const
     {
         return type() == obj_type::T_LIST;
     }
     
+    bool is_vector() const
+    {
+        return type() == obj_type::T_VECTOR;
+    }
+    
+    /// true for <>
+    bool is_nil() const
+    {
+        return is_cons() && !o_cons.car_;
+    }
+    
     /// is_pair()--tell if our argument object is a list of two elements
     bool is_pair() const;
     
@@ -193,11 +387,6 @@ public:
         return o_int;
     }
     
-    void bool_val(bool value)
-    {
-        o_int = value;
-    }
-    
     int int_val() const
     {
         return o_int;
@@ -211,7 +400,14 @@ public:
     /// list_length()--return length of a list
     int list_length() const;
     
-    static live_obj_ptr undefined();
+    /// at_least()--tell if a list has n or more elements, looking no further
+    bool at_least(int n) const;
+    
+    /// construct the undefined object in storage from the pool
+    static live_obj_ptr undefined(void * _Nonnull where);
 };
 
+static_assert(sizeof(object) <= sizeof(unsigned) * 2 + sizeof(cons_cell),
+              "object cells should be a header word plus a cons");
+
 #endif
@@ -0,0 +1,929 @@
+/*
+ * optimize.cpp--rewrite function ASTs by the algebra of programs
+ *
+ *	Backus gave FP laws by which one program may stand in for another.
+ *	The ones here make a program cheaper without changing what it
+ *	gives, ? included--every function is strict, so a law only needs
+ *	care where it would drop a function which might have given ?.
+ *	Definitions are rewritten when defined, and each application just
+ *	before it runs:
+ *
+ *	    f@id, id@f			f
+ *	    &f@&g			&(f@g), when neither can print
+ *	    tl@tl@...			one 'D' node, dropping k elements
+ *	    k@tl, k@(k' tl's)		the selector k+1, k+k'
+ *	    k@[f1, ..., fn]		fk, when the others always give a value
+ *	    [f@h, g@h, ...]		[f, g, ...]@h, when h can't call out or loop
+ *	    (p@h -> f@h ; g@h)		(p -> f ; g)@h, likewise
+ *	    (%T -> f ; g)		f, and g for %F
+ *	    [%a, %b, ...]		%<a b ...>
+ *	    f@%c			%(f:c), when f can't call out or loop
+ *
+ *	Each works on a whole chain of compositions at once, and they go
+ *	round again until none applies.  Then runs of the chain which pass
+ *	lists from one to the next, and print nothing, become pipelines
+ *	('P'), which stream the elements through without building the
+ *	lists in between:
+ *
+ *	    &f@&g@iota			one pass over 1..n
+ *	    concat@&(p -> [f] ; %<>)	a filter
+ *	    !g@&f, |g@&f, length@&f	a map feeding a reduction
+ *
+ *	Last, spelled-out linear algebra (inner and matrix products)
+ *	becomes 'V' nodes, which run a kernel in vector_ops.cpp when the
+ *	argument is numbers of the right shape, and the functions as
+ *	written otherwise.
+ *
+ *	A definition may also have the small functions it calls spliced
+ *	in, so the laws see across the calls and the calls cost nothing;
+ *	symtab_entry redoes that for any function it spliced a function
+ *	into when the latter is redefined.
+ */
+#include <stdio.h>
+#include <algorithm>
+#include <vector>
+#include "fpcommon.h"
+#include "optimize.h"
+#include "yystype.h"
+#include "ast.h"
+#include "ast.hpp"
+#include "exec.h"
+#include "intrin.h"
+#include "obj.h"
+#include "object.hpp"
+#include "symtab.h"
+#include "list_builder.hpp"
+#include "forms.hpp"
+#include "idiom.hpp"
+#include "symtab_entry.hpp"
+#include "y.tab.h"
+
+/// Rewriting is on
+static bool enabled = true;
+/// Print each tree after rewriting
+static bool showing = false;
+
+/// Biggest list a folded constant may be
+static constexpr int FOLD_MAX = 256;
+
+    /*
+     * Biggest function, in AST nodes with everything spliced into it,
+     *	which may be spliced in for a call.  Override with -DINLINE_MAX=n.
+     */
+#ifndef INLINE_MAX
+#define INLINE_MAX 24
+#endif
+
+static live_ast_ptr rewrite(live_ast_ptr act);
+static void pipelines(std::vector<live_ast_ptr> &fns);
+static void idioms(std::vector<live_ast_ptr> &fns);
+static live_ast_ptr pipe_idiom(live_ast_ptr pipe);
+
+/// The token of an intrinsic node, or 0
+static int
+intrinsic_of(live_ast_ptr act)
+{
+    if( act->tag != 'i' )
+        return(0);
+    return act->val.YYsym->sym_val.YYint;
+}
+
+/// Free one node, leaving its children be
+static void
+free_node(live_ast_ptr act)
+{
+    act->left = act->middle = act->right = nullptr;
+    if( act->tag == '%' )
+        act->val.YYobj->inc_ref();	// ast_freetree() drops it
+    ast_freetree(act);
+}
+
+/// Tell if two trees are the same function, written the same way
+static bool
+same_tree(ast_ptr a, ast_ptr b)
+{
+    if( !a || !b )
+        return( a == b );
+    if( a->tag != b->tag )
+        return(false);
+    switch( a->tag ){
+    case 'i':
+    case 'U':
+        if( a->val.YYsym != b->val.YYsym )
+            return(false);
+        break;
+    case 'S':
+    case 'D':
+    case 'c':
+    case 'P':
+    case 'V':
+        if( a->val.YYint != b->val.YYint )
+            return(false);
+        break;
+    case '%':
+        if( a->val.YYobj != b->val.YYobj )
+            return(false);
+        break;
+    }
+    return same_tree(a->left, b->left) && same_tree(a->middle, b->middle) &&
+        same_tree(a->right, b->right);
+}
+
+/// Tell if act gives a value for any argument but ?
+static bool
+total(live_ast_ptr act)
+{
+    switch( act->tag ){
+    case '%':
+        return( !act->val.YYobj->is_undef() );
+    case 'i':
+        return( intrinsic_of(act) == ID );
+    case '[':
+        for( ast_ptr a = act->left; a; a = a->right ){
+            if( !total(a->live_left()) )
+                return(false);
+        }
+        return(true);
+    }
+    return(false);
+}
+
+    /*
+     * Tell if act may print something.  A user function may be redefined
+     *	to print after this rewrite, so any call of one might.
+     */
+static bool
+prints(ast_ptr act)
+{
+    if( !act )
+        return(false);
+    switch( act->tag ){
+    case 'U':
+        return(true);
+    case 'i':
+        return( intrin_prints(act->val.YYsym) );
+    }
+    return prints(act->left) || prints(act->middle) || prints(act->right);
+}
+
+    /*
+     * Tell if act may be run at rewrite time: it calls no user function
+     *	(which might be redefined), has no while (which might not stop),
+     *	and prints nothing.
+     */
+static bool
+foldable(ast_ptr act)
+{
+    if( !act )
+        return(true);
+    switch( act->tag ){
+    case 'U':
+    case 'W':
+        return(false);
+    case 'i':
+        return( !intrin_prints(act->val.YYsym) );
+    }
+    return foldable(act->left) && foldable(act->middle) && foldable(act->right);
+}
+
+/// The functions of a composition, the one applied first last; frees the '@'s
+static std::vector<live_ast_ptr>
+unchain(live_ast_ptr act)
+{
+    std::vector<live_ast_ptr> fns;
+    while( act->tag == '@' ){
+        auto next = act->live_right();
+        fns.push_back(act->live_left());
+        free_node(act);
+        act = next;
+    }
+    fns.push_back(act);
+    return(fns);
+}
+
+/// The composition of fns, or the one function if there's just one
+static live_ast_ptr
+chain(const std::vector<live_ast_ptr> &fns)
+{
+    assert(!fns.empty());
+    live_ast_ptr act = fns.back();
+    for( auto x = fns.size() - 1; x-- > 0; )
+        act = ast_alloc('@', fns[x], nullptr, act);
+    return(act);
+}
+
+/// The function a composition applies first, or act itself
+static live_ast_ptr
+first_applied(live_ast_ptr act)
+{
+    while( act->tag == '@' )
+        act = act->live_right();
+    return(act);
+}
+
+/// A node for the id intrinsic
+static live_ast_ptr
+id_node(void)
+{
+    return ast_intrinsic(lookup("id"));
+}
+
+/// Tell if act is k tl's in a row, and how many
+static int
+drops(live_ast_ptr act)
+{
+    if( act->tag == 'D' )
+        return act->val.YYint;
+    return( intrinsic_of(act) == TL ? 1 : 0 );
+}
+
+/// &op with a vector kernel for when trans, distl or distr came first
+static bool
+kernel_map(live_ast_ptr map, live_ast_ptr next)
+{
+    if( map->tag != '&' || map->live_left()->tag != 'c' )
+        return(false);
+    switch( map->live_left()->val.YYint ){
+    case '+': case '-': case '*': case '/':
+        break;
+    default:
+        return(false);
+    }
+    switch( intrinsic_of(next) ){
+    case TRANS: case DISTL: case DISTR:
+        return(true);
+    }
+    return(false);
+}
+
+    /*
+     * f:c at rewrite time, if it gives a value small enough to keep in
+     *	the tree; else null.
+     */
+static obj_ptr
+fold(live_ast_ptr fn, live_obj_ptr c)
+{
+    if( c->is_undef() )
+        return(nullptr);
+    c->inc_ref();
+    auto r = execute(fn, c);
+    if( r->is_undef() || (r->is_list() && r->at_least(FOLD_MAX + 1)) ){
+        obj_unref(r);
+        return(nullptr);
+    }
+    return(r);
+}
+
+    /*
+     * One law applied to fns[x]@fns[x+1], if one applies.  On the way in
+     *	fns[x+1] runs first; on the way out fns has been changed to match.
+     */
+static bool
+rewrite_pair(std::vector<live_ast_ptr> &fns, size_t x)
+{
+    auto a = fns[x];
+    auto b = fns[x + 1];
+
+	// f@id, id@f
+    if( intrinsic_of(b) == ID ){
+        ast_freetree(b);
+        fns.erase(fns.begin() + static_cast<long>(x) + 1);
+        return(true);
+    }
+    if( intrinsic_of(a) == ID ){
+        ast_freetree(a);
+        fns.erase(fns.begin() + static_cast<long>(x));
+        return(true);
+    }
+
+	/*
+	 * &f@&g.  Not when the two are intrinsics, or &g has a vector
+	 *	kernel with what comes before it; those run unboxed as they are.
+	 *	Nor when either may print: f would run on each element before g
+	 *	had seen the next, and g would not see those after one f gave ?
+	 *	for.
+	 */
+    if( a->tag == '&' && b->tag == '&' && !prints(a) && !prints(b) &&
+        !(a->live_left()->tag == 'i' && b->live_left()->tag == 'i') &&
+        !(x + 2 < fns.size() && kernel_map(b, fns[x + 2])) ){
+        std::vector<live_ast_ptr> inner{a->live_left(), b->live_left()};
+        a->left = rewrite(chain(inner));
+        free_node(b);
+        fns.erase(fns.begin() + static_cast<long>(x) + 1);
+        return(true);
+    }
+
+	// tl@tl, and selectors after tl's
+    if( const int k = drops(b) ){
+        if( const int j = drops(a) ){
+            if( a->tag != 'D' ){
+                ast_freetree(a);
+                a = fns[x] = ast_alloc('D');
+            }
+            a->val.YYint = j + k;
+            ast_freetree(b);
+            fns.erase(fns.begin() + static_cast<long>(x) + 1);
+            return(true);
+        }
+        if( a->tag == 'S' && a->val.YYint > 0 ){
+            a->val.YYint += k;
+            ast_freetree(b);
+            fns.erase(fns.begin() + static_cast<long>(x) + 1);
+            return(true);
+        }
+    }
+
+	// k@[f1, ..., fn]
+    if( a->tag == 'S' && b->tag == '[' ){
+        std::vector<live_ast_ptr> members;
+        for( ast_ptr m = b->left; m; m = m->right )
+            members.push_back(m->live_left());
+        const int n = static_cast<int>(members.size());
+        int k = a->val.YYint;
+        if( k < 0 )
+            k += n + 1;
+        if( k < 1 || k > n )
+            return(false);
+        for( int y = 0; y < n; ++y ){
+            if( y != k - 1 && !total(members[static_cast<size_t>(y)]) )
+                return(false);
+        }
+        auto keep = members[static_cast<size_t>(k - 1)];
+        for( ast_ptr m = b->left; m; m = m->right ){
+            if( m->left == keep )
+                m->left = nullptr;
+        }
+        ast_freetree(b);
+        ast_freetree(a);
+        fns[x] = keep;
+        fns.erase(fns.begin() + static_cast<long>(x) + 1);
+        return(true);
+    }
+
+	/*
+	 * f@%c, or the longest run of foldable functions before %c whose
+	 *	result is small enough; length@iota@%1000 folds though
+	 *	iota@%1000 alone is too big to keep.
+	 */
+    if( b->tag == '%' && foldable(a) ){
+        auto y = x;
+        while( y > 0 && foldable(fns[y - 1]) )
+            --y;
+        for( ; y <= x; ++y ){
+            std::vector<live_ast_ptr> run(fns.begin() + static_cast<long>(y),
+                                          fns.begin() + static_cast<long>(x) + 1);
+            auto fn = chain(run);
+            auto r = fold(fn, b->val.YYobj);
+            while( fn->tag == '@' ){
+                auto next = fn->live_right();
+                free_node(fn);
+                fn = next;
+            }
+            if( !r )
+                continue;
+            obj_unref(b->val.YYobj);
+            b->val.YYobj = static_cast<live_obj_ptr>(r);
+            for( auto f: run )
+                ast_freetree(f);
+            fns.erase(fns.begin() + static_cast<long>(y), fns.begin() + static_cast<long>(x) + 1);
+            return(true);
+        }
+    }
+    return(false);
+}
+
+/// A chain of compositions, and everything in it
+static live_ast_ptr
+composition(live_ast_ptr act)
+{
+    std::vector<live_ast_ptr> fns;
+    for( auto fn: unchain(act) ){
+        fn = rewrite(fn);
+        if( fn->tag == '@' ){
+            auto more = unchain(fn);
+            fns.insert(fns.end(), more.begin(), more.end());
+        } else
+            fns.push_back(fn);
+    }
+
+    bool changed = true;
+    while( changed ){
+        changed = false;
+        for( size_t x = 0; x + 1 < fns.size(); ++x ){
+            if( rewrite_pair(fns, x) ){
+                changed = true;
+                break;
+            }
+        }
+
+	    // A law may have left a composition in the chain
+        for( size_t x = 0; x < fns.size(); ++x ){
+            if( fns[x]->tag != '@' )
+                continue;
+            auto more = unchain(fns[x]);
+            fns.erase(fns.begin() + static_cast<long>(x));
+            fns.insert(fns.begin() + static_cast<long>(x), more.begin(), more.end());
+            changed = true;
+        }
+    }
+    pipelines(fns);
+    idioms(fns);
+    return chain(fns);
+}
+
+/// &f as a pipeline stage: not one of the math functions & runs unboxed
+static bool
+map_stage(live_ast_ptr act)
+{
+    if( act->tag != '&' || prints(act) )
+        return(false);
+    switch( intrinsic_of(act->live_left()) ){
+    case SIN: case COS: case TAN: case ASIN: case ACOS: case ATAN:
+    case LOG: case EXP:
+        return(false);
+    }
+    return(true);
+}
+
+    /*
+     * The stage for concat@&h: a filter 'k' (p, and f or nothing for id)
+     *	when h is (p -> [f] ; %<>), 'K' (p, f) when it is (p -> f ; %<>),
+     *	else 'f' (h).  Frees the nodes it takes apart.
+     */
+static live_ast_ptr
+flat_stage(live_ast_ptr h)
+{
+    if( h->tag != '>' || h->live_right()->tag != '%' ||
+        !h->live_right()->val.YYobj->is_nil() )
+        return ast_alloc('f', h, nullptr, nullptr);
+    auto p = h->live_left();
+    auto f = h->live_middle();
+    ast_freetree(h->live_right());
+    free_node(h);
+    if( f->tag != '[' || f->live_left()->right )
+        return ast_alloc('K', p, f, nullptr);
+    auto g = f->live_left()->live_left();
+    free_node(f->live_left());
+    free_node(f);
+    if( intrinsic_of(g) == ID ){
+        ast_freetree(g);
+        return ast_alloc('k', p, nullptr, nullptr);
+    }
+    return ast_alloc('k', p, g, nullptr);
+}
+
+    /*
+     * Find runs of fns which can go as one pipeline, working from the
+     *	end applied first: an optional source (iota, distl, distr), stages
+     *	(&f, and concat@&f), and an optional sink (!f, |f, length).  A run
+     *	becomes a 'P' node if it saves building at least one list.  An &op
+     *	right after trans, distl or distr is left for its vector kernel.
+     *	Nothing which may print goes in, since the stages take turns at
+     *	each element.
+     */
+static void
+pipelines(std::vector<live_ast_ptr> &fns)
+{
+    auto end = fns.size();
+    while( end > 0 ){
+        auto y = end;
+        auto from = pipe_from::ELEMS;
+        switch( intrinsic_of(fns[y - 1]) ){
+        case IOTA:
+            from = pipe_from::COUNT;
+            break;
+        case DISTL:
+            from = pipe_from::DIST_LEFT;
+            break;
+        case DISTR:
+            from = pipe_from::DIST_RIGHT;
+            break;
+        }
+        if( from != pipe_from::ELEMS && !(y > 1 && kernel_map(fns[y - 2], fns[y - 1])) )
+            --y;
+        else
+            from = pipe_from::ELEMS;
+
+	    // Each stage, by where its '&' is, and whether it is flat
+        std::vector<std::pair<size_t, bool>> stages;
+        int saved = (from == pipe_from::ELEMS) ? -1 : 0;
+        while( y > 0 ){
+            auto fn = fns[y - 1];
+            if( y > 1 && fn->tag == '&' && !prints(fn) && intrinsic_of(fns[y - 2]) == CONCAT ){
+                stages.push_back({y - 1, true});
+                saved += 2;
+                y -= 2;
+            } else if( map_stage(fn) && !(y < fns.size() && kernel_map(fn, fns[y])) ){
+                stages.push_back({y - 1, false});
+                saved += 1;
+                y -= 1;
+            } else
+                break;
+        }
+        ast_ptr sink = nullptr;
+        if( !stages.empty() && y > 0 ){
+            auto fn = fns[y - 1];
+            if( intrinsic_of(fn) == LENGTH ){
+                sink = fn;
+                saved += 1;
+            } else if( (fn->tag == '!' || fn->tag == '|') && !prints(fn) )
+                sink = fn;
+            if( sink )
+                --y;
+        }
+        if( stages.empty() || saved < 1 ){
+            --end;
+            continue;
+        }
+
+        auto pipe = ast_alloc('P', nullptr, nullptr, sink);
+        pipe->val.YYint = static_cast<int>(from);
+        if( from != pipe_from::ELEMS )
+            pipe->middle = fns[end - 1];
+        ast_ptr *link = &pipe->left;
+        for( auto stage: stages ){
+            auto amp = fns[stage.first];
+            auto fn = amp->live_left();
+            free_node(amp);
+            live_ast_ptr cell;
+            if( stage.second ){
+                ast_freetree(fns[stage.first - 1]);
+                cell = flat_stage(fn);
+            } else
+                cell = ast_alloc('m', fn, nullptr, nullptr);
+            *link = cell;
+            link = &cell->right;
+        }
+        fns.erase(fns.begin() + static_cast<long>(y), fns.begin() + static_cast<long>(end));
+        fns.insert(fns.begin() + static_cast<long>(y), pipe);
+        end = y;
+    }
+}
+
+    /*
+     * If every one of fns ends by applying the same function first,
+     *	take it off each of them and give it back; else null.  A function
+     *	which is just that one becomes id.  One which might print is
+     *	left in each, since run once it would print once.
+     */
+static ast_ptr
+common_first(std::vector<live_ast_ptr> &fns)
+{
+    if( fns.size() < 2 )
+        return(nullptr);
+    auto h = first_applied(fns[0]);
+    bool any_chain = false;
+    for( auto fn: fns ){
+        if( !same_tree(first_applied(fn), h) )
+            return(nullptr);
+        any_chain = any_chain || (fn->tag == '@');
+    }
+    if( !any_chain || intrinsic_of(h) == ID || !foldable(h) )
+        return(nullptr);
+
+    ast_ptr kept = nullptr;
+    for( auto &fn: fns ){
+        live_ast_ptr last;
+        if( fn->tag == '@' ){
+            auto parts = unchain(fn);
+            last = parts.back();
+            parts.pop_back();
+            fn = chain(parts);
+        } else {
+            last = fn;
+            fn = id_node();
+        }
+        if( kept )
+            ast_freetree(last);
+        else
+            kept = last;
+    }
+    return(kept);
+}
+
+/// [f1, ..., fn], and everything in it
+static live_ast_ptr
+construction(live_ast_ptr act)
+{
+    std::vector<live_ast_ptr> members;
+    bool constant = true;
+    for( ast_ptr m = act->left; m; m = m->right ){
+        auto fn = rewrite(m->live_left());
+        m->left = fn;
+        members.push_back(fn);
+        constant = constant && fn->tag == '%' && !fn->val.YYobj->is_undef();
+    }
+
+	// [%a, %b, ...]
+    if( constant ){
+        list_builder b{static_cast<unsigned>(members.size())};
+        for( auto fn: members ){
+            fn->val.YYobj->inc_ref();
+            b.push(fn->val.YYobj);
+        }
+        ast_freetree(act);
+        auto c = ast_alloc('%');
+        c->val.YYobj = b.finish();
+        return(c);
+    }
+
+	// [f@h, g@h, ...]
+    if( auto h = common_first(members) ){
+        auto m = act->left;
+        for( auto fn: members ){
+            m->left = fn;
+            m = m->right;
+        }
+        return ast_alloc('@', act, nullptr, h);
+    }
+    return(act);
+}
+
+/// (p -> f ; g), and everything in it
+static live_ast_ptr
+conditional(live_ast_ptr act)
+{
+    act->left = rewrite(act->live_left());
+    act->middle = rewrite(act->live_middle());
+    act->right = rewrite(act->live_right());
+
+	// (%T -> f ; g), (%F -> f ; g)
+    auto p = act->live_left();
+    if( p->tag == '%' && p->val.YYobj->is_bool() ){
+        auto keep = p->val.YYobj->bool_val() ? act->live_middle() : act->live_right();
+        if( keep == act->middle )
+            act->middle = nullptr;
+        else
+            act->right = nullptr;
+        ast_freetree(act);
+        return(keep);
+    }
+
+	// (p@h -> f@h ; g@h)
+    std::vector<live_ast_ptr> parts{act->live_left(), act->live_middle(), act->live_right()};
+    if( auto h = common_first(parts) ){
+        act->left = parts[0];
+        act->middle = parts[1];
+        act->right = parts[2];
+        return ast_alloc('@', act, nullptr, h);
+    }
+    return(act);
+}
+
+/// Tell if act is the binary function op
+static bool
+is_char(live_ast_ptr act, int op)
+{
+    return( act->tag == 'c' && act->val.YYint == op );
+}
+
+/// Tell if act is &op@form, with form an intrinsic
+static bool
+is_map_of(live_ast_ptr act, int op, int form)
+{
+    return( act->tag == '@' && act->live_left()->tag == '&' &&
+            is_char(act->live_left()->live_left(), op) &&
+            intrinsic_of(act->live_right()) == form );
+}
+
+/// The 'V' node for kernel over fn
+static live_ast_ptr
+idiom_node(idiom kernel, live_ast_ptr fn)
+{
+    auto act = ast_alloc('V', fn, nullptr, nullptr);
+    act->val.YYint = static_cast<int>(kernel);
+    return(act);
+}
+
+/// The function a pipeline with one &f stage and no sink applies, if so
+static ast_ptr
+only_map(live_ast_ptr pipe)
+{
+    if( pipe->tag != 'P' || pipe->right )
+        return(nullptr);
+    auto stage = pipe->live_left();
+    if( stage->tag != 'm' || stage->right )
+        return(nullptr);
+    return(stage->left);
+}
+
+/// Tell if fn is a 'V' node running kernel
+static bool
+is_idiom(ast_ptr fn, idiom kernel)
+{
+    return( fn && fn->tag == 'V' && fn->val.YYint == static_cast<int>(kernel) );
+}
+
+/// Tell if act is [1, trans@2]
+static bool
+is_first_trans_second(live_ast_ptr act)
+{
+    if( act->tag != '[' )
+        return(false);
+    auto first = act->live_left();
+    auto second = first->right;
+    if( !second || second->right )
+        return(false);
+    auto a = first->live_left();
+    auto b = second->live_left();
+    return( a->tag == 'S' && a->val.YYint == 1 && b->tag == '@' &&
+            intrinsic_of(b->live_left()) == TRANS && b->live_right()->tag == 'S' &&
+            b->live_right()->val.YYint == 2 );
+}
+
+    /*
+     * &DOT@distl or &DOT@distr, as pipelines() left it, as one 'V' node
+     *	over the pipeline; else the pipeline.
+     */
+static live_ast_ptr
+pipe_idiom(live_ast_ptr pipe)
+{
+    if( !is_idiom(only_map(pipe), idiom::DOT) )
+        return(pipe);
+    switch( static_cast<pipe_from>(pipe->val.YYint) ){
+    case pipe_from::DIST_LEFT:
+        return idiom_node(idiom::DOT_ROWS_LEFT, pipe);
+    case pipe_from::DIST_RIGHT:
+        return idiom_node(idiom::DOT_ROWS_RIGHT, pipe);
+    default:
+        return(pipe);
+    }
+}
+
+    /*
+     * Runs of fns which spell out linear algebra, each made a 'V' node
+     *	over the run, whose kernel in vector_ops.cpp takes the argument
+     *	if it is numbers of the right shape.  Run after pipelines(), so
+     *	some are matched in the form it leaves them in:
+     *
+     *	    !+@&*@trans, |+@&*@trans		DOT, DOT_BINARY
+     *	    &DOT@distl, &DOT@distr		DOT_ROWS_LEFT, _RIGHT
+     *	    !(&+@trans)@&(&*@distl)@trans	VEC_MAT
+     *	    &DOT_ROWS_LEFT@distr@[1, trans@2]	MAT_MUL
+     */
+static void
+idioms(std::vector<live_ast_ptr> &fns)
+{
+    for( size_t x = 0; x < fns.size(); ++x ){
+        auto fn = fns[x];
+        size_t len = 0;
+        idiom kernel = idiom::DOT;
+        if( fn->tag == 'P' ){
+            fns[x] = pipe_idiom(fn);
+            if( fns[x] != fn )
+                continue;
+        }
+        if( x + 2 < fns.size() && (fn->tag == '!' || fn->tag == '|') &&
+            is_char(fn->live_left(), '+') && fns[x + 1]->tag == '&' &&
+            is_char(fns[x + 1]->live_left(), '*') && intrinsic_of(fns[x + 2]) == TRANS ){
+            kernel = (fn->tag == '!') ? idiom::DOT : idiom::DOT_BINARY;
+            len = 3;
+        } else if( x + 2 < fns.size() && fn->tag == '!' &&
+                   is_map_of(fn->live_left(), '+', TRANS) && fns[x + 1]->tag == '&' &&
+                   is_map_of(fns[x + 1]->live_left(), '*', DISTL) &&
+                   intrinsic_of(fns[x + 2]) == TRANS ){
+            kernel = idiom::VEC_MAT;
+            len = 3;
+        } else if( x + 1 < fns.size() && fn->tag == 'P' &&
+                   static_cast<pipe_from>(fn->val.YYint) == pipe_from::DIST_RIGHT &&
+                   is_idiom(only_map(fn), idiom::DOT_ROWS_LEFT) &&
+                   is_first_trans_second(fns[x + 1]) ){
+            kernel = idiom::MAT_MUL;
+            len = 2;
+        } else
+            continue;
+
+        std::vector<live_ast_ptr> run(fns.begin() + static_cast<long>(x),
+                                      fns.begin() + static_cast<long>(x + len));
+        fns.erase(fns.begin() + static_cast<long>(x), fns.begin() + static_cast<long>(x + len));
+        fns.insert(fns.begin() + static_cast<long>(x), idiom_node(kernel, chain(run)));
+    }
+}
+
+/// A pipeline from an earlier rewrite, with its functions rewritten again
+static live_ast_ptr
+pipeline(live_ast_ptr act)
+{
+    for( ast_ptr stage = act->left; stage; stage = stage->right ){
+        stage->left = rewrite(stage->live_left());
+        if( stage->middle )
+            stage->middle = rewrite(stage->live_middle());
+    }
+    if( act->right && act->right->tag != 'i' )
+        act->right->left = rewrite(act->right->live_left());
+    return pipe_idiom(act);
+}
+
+/// Rewrite a tree, handing back what's left of it
+static live_ast_ptr
+rewrite(live_ast_ptr act)
+{
+    switch( act->tag ){
+    case '@':
+        return composition(act);
+    case '[':
+        return construction(act);
+    case '>':
+        return conditional(act);
+    case '&':
+    case '!':
+    case '|':
+        act->left = rewrite(act->live_left());
+        return(act);
+    case 'W':
+        act->left = rewrite(act->live_left());
+        act->right = rewrite(act->live_right());
+        return(act);
+    case 'P':
+        return pipeline(act);
+    }
+    return(act);
+}
+
+    /*
+     * Splice into act the functions it calls which, spliced in, come to
+     *	no more than INLINE_MAX nodes.  A function already being spliced
+     *	in (one calling itself, or two calling each other) stays a call,
+     *	as does one whose results are kept.
+     *	Each one spliced in goes on inlined.
+     */
+static live_ast_ptr
+splice(live_ast_ptr act, std::vector<sym_ptr> &active, std::vector<sym_ptr> &inlined)
+{
+    if( act->tag != 'U' ){
+        if( act->left )
+            act->left = splice(act->live_left(), active, inlined);
+        if( act->middle )
+            act->middle = splice(act->live_middle(), active, inlined);
+        if( act->right )
+            act->right = splice(act->live_right(), active, inlined);
+        return(act);
+    }
+    auto sym = static_cast<live_sym_ptr>(act->val.YYsym);
+    if( !sym->is_defined() || sym->sym_memo || ast_size(sym->sym_val.YYast) > INLINE_MAX ||
+        std::find(active.begin(), active.end(), sym) != active.end() )
+        return(act);
+
+    active.push_back(sym);
+    std::vector<sym_ptr> more;
+    auto body = splice(ast_copy(static_cast<live_ast_ptr>(sym->sym_val.YYast)), active, more);
+    active.pop_back();
+    if( ast_size(body) > INLINE_MAX ){
+        ast_freetree(body);
+        return(act);
+    }
+    ast_freetree(act);
+    inlined.push_back(sym);
+    for( auto p: more ){
+        if( std::find(inlined.begin(), inlined.end(), p) == inlined.end() )
+            inlined.push_back(p);
+    }
+    return(body);
+}
+
+live_ast_ptr
+opt_inline(live_sym_ptr sym)
+{
+    if( !enabled )
+        return(nullptr);
+    std::vector<sym_ptr> active{sym};
+    auto body = splice(ast_copy(static_cast<live_ast_ptr>(sym->sym_val.YYast)), active, sym->sym_inlined);
+    if( sym->sym_inlined.empty() ){
+        ast_freetree(body);
+        return(nullptr);
+    }
+    body = rewrite(body);
+    if( showing ){
+        printf("=> ");
+        ast_print(body);
+        printf("\n");
+    }
+    return(body);
+}
+
+live_ast_ptr
+opt_rewrite(live_ast_ptr act)
+{
+    if( enabled )
+        act = rewrite(act);
+    if( showing ){
+        printf("=> ");
+        ast_print(act);
+        printf("\n");
+    }
+    return(act);
+}
+
+void
+opt_toggle(void)
+{
+    enabled = !enabled;
+    printf("Rewriting %s\n", enabled ? "on" : "off");
+}
+
+void
+opt_show_toggle(void)
+{
+    showing = !showing;
+    printf("Showing rewritten functions %s\n", showing ? "on" : "off");
+}
@@ -0,0 +1,14 @@
+#ifndef OPTIMIZE_H
+#define OPTIMIZE_H
+
+//optimize.cpp
+/// opt_rewrite()--rewrite a function by the laws of FP, giving what's left
+live_ast_ptr opt_rewrite(live_ast_ptr act);
+/// opt_inline()--sym's definition with small functions it calls spliced in, or null
+live_ast_ptr opt_inline(live_sym_ptr sym);
+/// opt_toggle()--switch rewriting on or off
+void opt_toggle(void);
+/// opt_show_toggle()--switch printing of rewritten functions on or off
+void opt_show_toggle(void);
+
+#endif
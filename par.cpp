@@ -0,0 +1,437 @@
+/*
+ * par.cpp--apply functions on several threads at once
+ *
+ *	The applications &f makes of f don't depend on each other, so a
+ *	long enough list is spread over a pool of threads.  Each thread
+ *	keeps a deque of tasks, each a range of elements.  It works from
+ *	the back of its own deque, and when that is empty steals from the
+ *	front of another's, where the biggest ranges are.
+ *
+ *	A thread works through its range an element at a time, and every
+ *	time it finds its own deque empty, puts the top half of what is
+ *	left there for a thief.  So a range is only cut as finely as idle
+ *	threads ask for: a list of a few slow elements is spread one to a
+ *	thread, and one of many quick ones goes in big pieces.
+ *
+ *	Only the main thread starts parallel work.  While it goes on, obj.c
+ *	hands out cells through a cache for each thread and refcounts are
+ *	changed atomically.  A thread waiting for its tasks works on others
+ *	meanwhile, so & within & spreads out too.
+ *
+ *	The members of a construction and the halves of a | are forked the
+ *	same way, as the elements of a short job.  Whether one is worth it
+ *	goes by how big its argument is, and how long the same construction
+ *	or | took for each unit of that the last times it was forked; this
+ *	is kept in the node's val.  A thread which already has a task
+ *	waiting for a thief forks nothing more, so down a deep recursion
+ *	only the levels the idle threads ask for are split.
+ */
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include "fpcommon.h"
+#include "depth.h"
+#include "intrin.h"
+#include "obj.h"
+#include "par.h"
+#include "object.hpp"
+#include "yystype.h"
+#include "ast.hpp"
+#include "list_iter.hpp"
+#include "refcount.hpp"
+#include "symtab_entry.hpp"
+#include "y.tab.h"
+
+    /*
+     * Threads to use, the main one included; 0 means one per core.
+     *	Override with -DPAR_THREADS=n, or )par n.
+     */
+#ifndef PAR_THREADS
+#define PAR_THREADS 0
+#endif
+
+    /*
+     * Shortest list & spreads over the threads when its function calls
+     *	user functions or loops, and when it doesn't.  Override with
+     *	-DPAR_MIN=n -DPAR_MIN_SIMPLE=n.
+     */
+#ifndef PAR_MIN
+#define PAR_MIN 2
+#endif
+#ifndef PAR_MIN_SIMPLE
+#define PAR_MIN_SIMPLE 16384
+#endif
+
+    /*
+     * Least time, in nanoseconds, a construction or | should take for it
+     *	to be forked.  Override with -DPAR_FORK_NS=n.
+     */
+#ifndef PAR_FORK_NS
+#define PAR_FORK_NS 10000
+#endif
+
+/// Most threads there can be
+static constexpr unsigned MAX_THREADS = 256;
+/// Times an idle thread looks for work before it sleeps
+static constexpr unsigned SPINS = 64;
+
+/// One call of par_for()
+struct par_job final {
+    void (* _Nonnull body)(void * _Nonnull ctx, unsigned x);
+    void * _Nonnull ctx;
+    /// Its tasks not yet done
+    std::atomic<unsigned> pending;
+};
+
+/// Elements lo up to hi of a job
+struct par_task final {
+    par_job * _Nullable job;
+    unsigned lo;
+    unsigned hi;
+};
+
+/// A thread's tasks
+struct par_deque final {
+    std::mutex lock;
+    std::deque<par_task> tasks;
+    /// How many there are, for a look without the lock
+    std::atomic<unsigned> size{0};
+};
+static par_deque deques[MAX_THREADS];
+
+/// Threads in use; only main changes this, while they are idle
+static std::atomic<unsigned> threads{0};
+/// Threads started so far, main included
+static unsigned started = 1;
+/// This thread's deque; main's is 0
+static thread_local unsigned self = 0;
+
+/// Tasks in all the deques
+static std::atomic<unsigned> queued{0};
+/// Threads asleep waiting for tasks
+static std::atomic<unsigned> sleepers{0};
+
+    /*
+     * For sleeping on while there's nothing to do.  Made once and never
+     *	destroyed, since the threads are still waiting on it when exit()
+     *	runs the static destructors.
+     */
+struct par_sync {
+    std::mutex lock;
+    std::condition_variable work_ready;
+};
+static par_sync *idle = nullptr;
+
+/// The main thread has parallel work going
+static std::atomic<bool> busy{false};
+/// An interrupt came in while it did
+static std::atomic<bool> interrupted{false};
+
+/// Put a task on the back of this thread's deque
+static void
+push(par_task task)
+{
+    auto &d = deques[self];
+    {
+        std::lock_guard<std::mutex> hold{d.lock};
+        d.tasks.push_back(task);
+        d.size.fetch_add(1);
+    }
+    queued.fetch_add(1);
+    if( sleepers.load() ){
+        std::lock_guard<std::mutex> hold{idle->lock};
+        idle->work_ready.notify_one();
+    }
+}
+
+/// Take a task off the back of this thread's deque, or the front of another's
+static bool
+find(par_task &task)
+{
+    const unsigned n = threads.load(std::memory_order_relaxed);
+    for( unsigned y = 0; y < n; ++y ){
+        const unsigned victim = (self + y) % n;
+        auto &d = deques[victim];
+        if( !d.size.load(std::memory_order_relaxed) )
+            continue;
+        std::lock_guard<std::mutex> hold{d.lock};
+        if( d.tasks.empty() )
+            continue;
+        if( victim == self ){
+            task = d.tasks.back();
+            d.tasks.pop_back();
+        } else {
+            task = d.tasks.front();
+            d.tasks.pop_front();
+        }
+        d.size.fetch_sub(1);
+        queued.fetch_sub(1);
+        return(true);
+    }
+    return(false);
+}
+
+/// Work through a task, leaving half of it for a thief whenever none is waiting
+static void
+work(par_task task)
+{
+    auto job = task.job;
+    auto &mine = deques[self];
+    while( task.lo < task.hi ){
+        if( task.hi - task.lo > 1 && !mine.size.load(std::memory_order_relaxed) ){
+            const unsigned mid = task.lo + (task.hi - task.lo) / 2;
+            job->pending.fetch_add(1);
+            push(par_task{job, mid, task.hi});
+            task.hi = mid;
+        }
+        job->body(job->ctx, task.lo++);
+    }
+    job->pending.fetch_sub(1, std::memory_order_release);
+}
+
+/// A thread of the pool: find work, or sleep until there is some
+static void * _Nullable
+worker(void * _Nullable arg)
+{
+    self = static_cast<unsigned>(reinterpret_cast<uintptr_t>(arg));
+    depth_thread();
+    obj_thread();
+    for(;;){
+        par_task task;
+        bool found = false;
+        for( unsigned y = 0; y < SPINS && !found; ++y ){
+            if( self < threads.load(std::memory_order_relaxed) &&
+                queued.load(std::memory_order_relaxed) )
+                found = find(task);
+            if( !found )
+                std::this_thread::yield();
+        }
+        if( found ){
+            work(task);
+            continue;
+        }
+        std::unique_lock<std::mutex> hold{idle->lock};
+        sleepers.fetch_add(1);
+        idle->work_ready.wait(hold, []{
+            return self < threads.load() && queued.load() != 0;
+        });
+        sleepers.fetch_sub(1);
+    }
+}
+
+/// Start threads until there are enough, with signals left to the main one
+static void
+start_threads(void)
+{
+    const unsigned want = threads.load();
+    if( started >= want )
+        return;
+    if( !idle )
+        idle = new par_sync;
+    sigset_t all, old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_BLOCK, &all, &old);
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, depth_stack());
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    for( ; started < want; ++started ){
+        pthread_t thread;
+        auto arg = reinterpret_cast<void *>(static_cast<uintptr_t>(started));
+        if( pthread_create(&thread, &attr, worker, arg) != 0 ){
+            threads = started;
+            break;
+        }
+    }
+    pthread_attr_destroy(&attr);
+    pthread_sigmask(SIG_SETMASK, &old, nullptr);
+}
+
+/// One thread per core, or just the one if the system won't say
+static unsigned
+cores(void)
+{
+    const unsigned n = std::thread::hardware_concurrency();
+    if( !n )
+        return(1);
+    return( n < MAX_THREADS ? n : MAX_THREADS );
+}
+
+/// Threads in use, deciding on PAR_THREADS' number the first time
+static unsigned
+in_use(void)
+{
+    if( !threads.load(std::memory_order_relaxed) )
+        threads = PAR_THREADS ? PAR_THREADS : cores();
+    return( threads.load(std::memory_order_relaxed) );
+}
+
+void
+par_set(unsigned n)
+{
+    const unsigned now = in_use();
+    if( !n )
+        n = (now > 1) ? 1 : cores();
+    if( n > MAX_THREADS )
+        n = MAX_THREADS;
+    threads = n;
+    if( idle ){
+        std::lock_guard<std::mutex> hold{idle->lock};
+        idle->work_ready.notify_all();
+    }
+    if( n > 1 )
+        printf("Apply-to-all runs on %u threads\n", n);
+    else
+        printf("Apply-to-all runs on one thread\n");
+}
+
+    /*
+     * Tell if fn may be applied on several threads at once: it, and all
+     *	it calls, are defined and print nothing.  Note whether it calls a
+     *	user function or loops, which could take a while for each element.
+     */
+static bool
+ready(ast_ptr fn, bool &slow)
+{
+    if( !fn )
+        return(true);
+    switch( fn->tag ){
+    case 'i':
+        return( !intrin_prints(fn->val.YYsym) );
+    case 'U':
+        slow = true;
+        return( static_cast<live_sym_ptr>(fn->val.YYsym)->parallel_ok() );
+    case '&':
+    case '!':
+    case '|':
+    case 'W':
+    case 'P':
+        slow = true;
+        break;
+    }
+    return( ready(fn->left, slow) && ready(fn->middle, slow) && ready(fn->right, slow) );
+}
+
+bool
+par_wanted(live_ast_ptr fn, unsigned n)
+{
+    if( in_use() < 2 || n < PAR_MIN || obj_in_arena() )
+        return(false);
+    bool slow = false;
+    if( !ready(fn, slow) )
+        return(false);
+    return( slow || n >= PAR_MIN_SIMPLE );
+}
+
+void
+par_for(unsigned n, void (* _Nonnull body)(void * _Nonnull ctx, unsigned x),
+        void * _Nonnull ctx)
+{
+    par_job job{body, ctx, {1}};
+    const bool outer = !busy.load();
+    bool was_atomic = atomic_refs;
+    if( outer ){
+        start_threads();
+        atomic_refs = true;
+        obj_share(true);
+        busy = true;
+    }
+
+	// Do our share, then help with what's left until it's all done
+    work(par_task{&job, 0, n});
+    while( job.pending.load(std::memory_order_acquire) ){
+        par_task task;
+        if( find(task) )
+            work(task);
+        else
+            std::this_thread::yield();
+    }
+
+    if( outer ){
+        busy = false;
+        obj_share(false);
+        atomic_refs = was_atomic;
+        if( interrupted.exchange(false) )
+            raise(SIGINT);
+    }
+}
+
+    /*
+     * How much work obj looks like: its length, and those of the lists
+     *	among its first few elements, so that <pivot, list> counts the list.
+     */
+static unsigned
+weight(live_obj_ptr obj)
+{
+    if( !obj->is_list() )
+        return(1);
+    unsigned long n = 1 + obj->list_length();
+    if( !obj->is_packed() ){
+        int look = 4;
+        for( list_iter it{obj}; !it.done() && look-- > 0; it.next() ){
+            if( it.elem()->is_list() )
+                n += it.elem()->list_length();
+        }
+    }
+    return( n < UINT_MAX ? static_cast<unsigned>(n) : UINT_MAX );
+}
+
+unsigned
+par_fork(live_ast_ptr site, live_obj_ptr obj)
+{
+    if( in_use() < 2 || obj->is_undef() || obj_in_arena() )
+        return(0);
+    if( deques[self].size.load(std::memory_order_relaxed) )
+        return(0);
+    const unsigned size = weight(obj);
+    const int cost = __atomic_load_n(&site->val.YYint, __ATOMIC_RELAXED);
+    if( cost && static_cast<unsigned long long>(cost) * size < PAR_FORK_NS )
+        return(0);
+
+	// The tasks run in no order, so none of them may print
+    bool slow = false;
+    if( !ready(site, slow) )
+        return(0);
+    return(size);
+}
+
+void
+par_join(live_ast_ptr site, unsigned size, unsigned n,
+         void (* _Nonnull body)(void * _Nonnull ctx, unsigned x), void * _Nonnull ctx)
+{
+    const auto start = std::chrono::steady_clock::now();
+    par_for(n, body, ctx);
+    const auto took = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count();
+
+	// The time for each unit of size, averaged in with the last ones
+    long long each = took / size;
+    const int cost = __atomic_load_n(&site->val.YYint, __ATOMIC_RELAXED);
+    if( cost )
+        each = (3LL * cost + each) / 4;
+    if( each < 1 )
+        each = 1;
+    if( each > INT_MAX )
+        each = INT_MAX;
+    __atomic_store_n(&site->val.YYint, static_cast<int>(each), __ATOMIC_RELAXED);
+}
+
+bool
+par_busy(void)
+{
+    return( busy.load() );
+}
+
+void
+par_interrupt(void)
+{
+    interrupted = true;
+    depth_abandon();
+}
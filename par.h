@@ -0,0 +1,22 @@
+#ifndef PAR_H
+#define PAR_H
+
+//par.cpp
+/// par_set()--use this many threads, or switch between one and all the cores if 0
+void par_set(unsigned threads);
+/// par_wanted()--true if &fn over n elements is worth spreading over the threads
+bool par_wanted(live_ast_ptr fn, unsigned n);
+/// par_for()--call body(ctx, x) for each x below n, spread over the threads
+void par_for(unsigned n, void (* _Nonnull body)(void * _Nonnull ctx, unsigned x),
+             void * _Nonnull ctx);
+/// par_fork()--how much work obj looks like, if site (a construction or |) on it is worth tasks of its own now and prints nothing; else 0
+unsigned par_fork(live_ast_ptr site, live_obj_ptr obj);
+/// par_join()--par_for() at site on work of that size, timed to judge the next par_fork() there by
+void par_join(live_ast_ptr site, unsigned size, unsigned n,
+              void (* _Nonnull body)(void * _Nonnull ctx, unsigned x), void * _Nonnull ctx);
+/// par_busy()--true while the threads are at work for the main thread
+bool par_busy(void);
+/// par_interrupt()--stop the threads, and take the interrupt once they have
+void par_interrupt(void);
+
+#endif
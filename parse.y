@@ -15,6 +15,15 @@
 #include "obj.h"
 #include "object.hpp"
 #include "symtab_entry.hpp"
+#include "vm.h"
+#include "list.h"
+#include "optimize.h"
+
+/*
+ * YYstype is a plain union, so bison may grow its stacks on the heap
+ *	(up to YYMAXDEPTH) rather than stopping at YYINITDEPTH.
+ */
+#define YYSTYPE_IS_TRIVIAL 1
 
 static char had_undef = 0;
 
@@ -37,7 +46,7 @@ extern int obj_out, ast_out;
 %token SIN COS TAN ASIN ACOS ATAN LOG EXP MOD CONCAT LAST FIRST PICK
 %token TL HD ATOM NOT EQ NIL REVERSE DISTL DISTR LENGTH DIV
 %token TRANS APNDL APNDR TLR ROTL ROTR IOTA PAIR SPLIT OUT
-%token FRONT
+%token FRONT INTRINSIC
 
 %token WHILE
 %token '[' ']'
@@ -47,7 +56,7 @@ extern int obj_out, ast_out;
 %%
 go	:	go fpInput
 	|	go error
-		    { yyclearin; }
+		    { yyclearin; obj_arena_close(); }
 	|	Empty
 	;
 
@@ -66,6 +75,7 @@ fpInput
 	|	application
 		    {
 #ifdef MEMSTAT
+    obj_reclaim_wait();
     if( obj_out || ast_out ){
 	printf("%d objects lost, %d AST nodes lost\n",obj_out,ast_out);
     obj_out = 0;
@@ -91,15 +101,17 @@ fnDef	:	'{'
 	;
 
 application
-	:	    { set_prompt('-'); }
+	:	    { set_prompt('-'); obj_arena_open(); }
 	    funForm ':' object
 		    {
-			auto p = execute($2.YYast,$4.YYobj);
+			auto act = opt_rewrite($2.YYast);
+			auto p = vm_application(act,$4.YYobj);
 
 			obj_prtree(p);
 			printf("\n");
 			obj_unref(p);
-			ast_freetree($2.YYast);
+			ast_freetree(act);
+			obj_arena_close();
 			set_prompt('\t');
 		    }
 	;
@@ -130,18 +142,26 @@ object2	:	atom
 	;
 
 fpSequence
-	:	'<' object2 OptComma SeqBody '>'
+	:	'<' SeqBody '>'
 		    {
-                $$.YYobj = obj_alloc($2.YYobj, $4.YYobj);
+                auto p = list_reverse_unique($2.YYobj);
+                assert(p);
+                $$.YYobj = p;
 		    }
 	;
-SeqBody	:	Empty
+
+	/*
+	 * Left recursive, so a long list doesn't pile up on the parser's
+	 *	stack; the elements are linked up last first, and turned
+	 *	round when the list is done.
+	 */
+SeqBody	:	object2 OptComma
 		    {
-			$$.YYobj = 0;
+                $$.YYobj = obj_alloc($1.YYobj, nullptr);
 		    }
-	|	object2 OptComma SeqBody
+	|	SeqBody object2 OptComma
 		    {
-                $$.YYobj = obj_alloc($1.YYobj, $3.YYobj);
+                $$.YYobj = obj_alloc($2.YYobj, $1.YYobj);
 		    }
 	;
 
@@ -183,8 +203,7 @@ funForm	:	simpFn
 
 simpFn	:	IdFns
 		    {
-			$$.YYast = ast_alloc('i');
-			(($$.YYast)->val).YYsym = $1.YYsym;
+			$$.YYast = ast_intrinsic($1.YYsym);
 		    }
 	|	INT
 		    {
@@ -243,6 +262,7 @@ IdFns
 	|	AND
 	|	XOR
 	|	ID
+	|	INTRINSIC
 	;
 
 binaryFn
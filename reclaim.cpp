@@ -0,0 +1,134 @@
+/*
+ * reclaim.cpp--free big lists on a background thread
+ *
+ *	Dropping a list of millions of elements takes a while, and it
+ *	happens right when the user is waiting for the next prompt.  With
+ *	)bgfree switched on, a dead store of at least RECLAIM_MIN elements
+ *	is pushed on a lock-free stack instead, and a background thread
+ *	empties it.  The cells it frees find their way back to the main
+ *	thread's pool through obj.c's returned-cell stack.
+ */
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include "fpcommon.h"
+#include "obj.h"
+#include "reclaim.h"
+#include "vector_store.hpp"
+
+    /*
+     * Smallest store worth handing to the reclaim thread.  Override with
+     *	-DRECLAIM_MIN=n.
+     */
+#ifndef RECLAIM_MIN
+#define RECLAIM_MIN 65536
+#endif
+
+bool atomic_refs = false;
+
+/// Whether dead stores go to the reclaim thread; only main touches this
+static bool enabled = false;
+
+/// A dead store waiting for the reclaim thread
+struct reclaim_job {
+    vector_store * _Nonnull store;
+    reclaim_job * _Nullable next;
+};
+static std::atomic<reclaim_job *> jobs{nullptr};
+
+/// Jobs pushed but not yet finished
+static std::atomic<unsigned> pending{0};
+
+    /*
+     * The stack itself needs no lock; this one is only for sleeping on
+     *	while there's nothing to do, or while waiting for the thread to
+     *	finish.  It is made once and never destroyed, since the thread
+     *	is still waiting on it when exit() runs the static destructors.
+     */
+struct reclaim_sync {
+    std::mutex lock;
+    std::condition_variable work_ready;
+    std::condition_variable all_done;
+};
+static reclaim_sync *waits = nullptr;
+
+[[noreturn]] static void
+reclaimer(void)
+{
+    for(;;){
+        {
+            std::unique_lock<std::mutex> lock{waits->lock};
+            waits->work_ready.wait(lock, []{ return jobs.load() != nullptr; });
+        }
+        auto job = jobs.exchange(nullptr, std::memory_order_acquire);
+        while( job ){
+            obj_reclaim(job->store);
+            auto next = job->next;
+            delete job;
+            job = next;
+            if( pending.fetch_sub(1) == 1 ){
+                std::lock_guard<std::mutex> lock{waits->lock};
+                waits->all_done.notify_all();
+            }
+        }
+    }
+}
+
+bool
+reclaim_store(vector_store * _Nonnull store)
+{
+    if( !enabled || store->length < RECLAIM_MIN )
+        return(false);
+
+	// An unboxed store with no boxes is just one free() anyway
+    if( store->is_packed() && !store->boxes )
+        return(false);
+
+    auto job = new reclaim_job{store, jobs.load(std::memory_order_relaxed)};
+    pending.fetch_add(1);
+    while( !jobs.compare_exchange_weak(job->next, job,
+                std::memory_order_release, std::memory_order_relaxed) )
+        ;
+    std::lock_guard<std::mutex> lock{waits->lock};
+    waits->work_ready.notify_one();
+    return(true);
+}
+
+void
+reclaim_drain(void)
+{
+    if( !pending.load() )
+        return;
+    std::unique_lock<std::mutex> lock{waits->lock};
+    waits->all_done.wait(lock, []{ return pending.load() == 0; });
+}
+
+void
+reclaim_toggle(void)
+{
+    if( enabled ){
+	    // Nobody else may touch a refcount once they go back to plain
+        enabled = false;
+        reclaim_drain();
+        atomic_refs = false;
+        printf("Background freeing off\n");
+        return;
+    }
+    atomic_refs = true;
+    if( !waits ){
+        waits = new reclaim_sync;
+
+	    // Signals are for the main thread, whose stack intr() jumps to
+        sigset_t all, old;
+        sigfillset(&all);
+        pthread_sigmask(SIG_BLOCK, &all, &old);
+        std::thread{reclaimer}.detach();
+        pthread_sigmask(SIG_SETMASK, &old, nullptr);
+    }
+    enabled = true;
+    printf("Background freeing of lists of %d or more on\n", RECLAIM_MIN);
+}
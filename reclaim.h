@@ -0,0 +1,14 @@
+#ifndef RECLAIM_H
+#define RECLAIM_H
+
+struct vector_store;
+
+//reclaim.cpp
+/// reclaim_store()--true if the reclaim thread takes over a dead store
+bool reclaim_store(vector_store * _Nonnull store);
+/// reclaim_drain()--wait until the reclaim thread has nothing left to do
+void reclaim_drain(void);
+/// reclaim_toggle()--switch background freeing of big lists on or off
+void reclaim_toggle(void);
+
+#endif
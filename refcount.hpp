@@ -0,0 +1,41 @@
+#ifndef REFCOUNT_HPP
+#define REFCOUNT_HPP
+
+/**
+ * Reference counts are plain unsigneds, bumped with ordinary loads and
+ *	stores.  While the background reclaimer (reclaim.cpp) is switched
+ *	on, or par.cpp's threads are applying functions, other threads may
+ *	be taking and dropping references to the same objects, so for that
+ *	stretch every count is changed atomically instead.
+ */
+extern bool atomic_refs;
+
+/// Add a reference
+inline void
+ref_inc(unsigned &refs)
+{
+    if( atomic_refs )
+        __atomic_add_fetch(&refs, 1, __ATOMIC_RELAXED);
+    else
+        ++refs;
+}
+
+/// The current count
+inline unsigned
+ref_get(const unsigned &refs)
+{
+    if( atomic_refs )
+        return __atomic_load_n(&refs, __ATOMIC_ACQUIRE);
+    return refs;
+}
+
+/// Drop a reference, giving back the number left
+inline unsigned
+ref_dec(unsigned &refs)
+{
+    if( atomic_refs )
+        return __atomic_sub_fetch(&refs, 1, __ATOMIC_ACQ_REL);
+    return --refs;
+}
+
+#endif
@@ -1,7 +1,9 @@
 #include <setjmp.h>
 #include <signal.h>
 #include <stdio.h>
+#include "fpcommon.h"
 #include "lex.h"
+#include "par.h"
 #include "signal_handling.h"
 
 extern "C" [[noreturn]] void badmath(int ignored);
@@ -16,12 +18,17 @@ badmath(int /*ignored*/){
     longjmp(restart,1);
 }
 
-extern "C" [[noreturn]] void intr(int ignored);
+extern "C" void intr(int ignored);
 
 /// User interrupt handler
 extern "C"
-[[noreturn]] void
+void
 intr(int /*ignored*/){
+	// Other threads are at work for us; they must stop before we jump
+    if( par_busy() ){
+        par_interrupt();
+        return;
+    }
     printf("Interrupt\n");
     set_prompt('\t');
     signal(SIGINT, intr);
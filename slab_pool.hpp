@@ -0,0 +1,156 @@
+#ifndef SLAB_POOL_HPP
+#define SLAB_POOL_HPP
+
+#include <stddef.h>
+#include <new>
+
+/**
+ * A pool of fixed-size cells, carved out of large slabs.
+ *
+ * Freed cells are threaded onto an intrusive free list (the link lives
+ *	in the dead cell itself), so the steady state of alloc/release is a
+ *	couple of pointer moves.  Slabs are never handed back; the pool only
+ *	grows to the high-water mark of the program.
+ */
+template <size_t CELL_SIZE, size_t SLAB_SIZE = 64 * 1024>
+struct slab_pool final {
+    static_assert(CELL_SIZE >= sizeof(void *), "cell too small for a free link");
+    static_assert(SLAB_SIZE >= CELL_SIZE, "slab smaller than a cell");
+
+    /// How many cells one slab holds
+    static constexpr size_t CELLS_PER_SLAB = SLAB_SIZE / CELL_SIZE;
+
+    struct chain;
+
+    slab_pool() = default;
+    slab_pool(const slab_pool &) = delete;
+    slab_pool &operator=(const slab_pool &) = delete;
+
+    /// Hand out one uninitialized cell
+    void * _Nonnull alloc()
+    {
+        if( !free_list )
+            grow();
+        auto cell = free_list;
+        free_list = cell->next;
+        ++in_use;
+        return cell;
+    }
+
+    /// Hand out n uninitialized cells at once, linked up as a chain
+    chain alloc(size_t n)
+    {
+        chain c;
+        while( c.count < n ){
+            if( !free_list )
+                grow();
+            auto cell = free_list;
+            free_list = cell->next;
+            c.add(cell);
+        }
+        in_use += n;
+        return c;
+    }
+
+    /// Take back a cell obtained from alloc()
+    void release(void * _Nonnull p)
+    {
+        auto cell = static_cast<free_cell *>(p);
+        cell->next = free_list;
+        free_list = cell;
+        --in_use;
+    }
+
+    /// Take back a whole chain of cells at once, leaving the chain empty
+    void release(chain &c)
+    {
+        if( !c.head )
+            return;
+        c.tail->next = free_list;
+        free_list = c.head;
+        in_use -= c.count;
+        c = chain{};
+    }
+
+    /// true if alloc() can be had without a new slab
+    bool has_free() const
+    {
+        return free_list != nullptr;
+    }
+
+    /// Number of slabs obtained from the system so far
+    size_t slabs() const
+    {
+        return nslabs;
+    }
+
+    /// Number of cells currently handed out
+    size_t cells_in_use() const
+    {
+        return in_use;
+    }
+
+    /// Total number of cells in all slabs
+    size_t capacity() const
+    {
+        return nslabs * CELLS_PER_SLAB;
+    }
+
+private:
+    /// A dead cell, as seen by the free list
+    struct free_cell {
+        free_cell * _Nullable next;
+    };
+
+    /// Get a new slab in one piece and thread all of its cells
+    void grow()
+    {
+        auto base = static_cast<char *>(::operator new(SLAB_SIZE));
+        ++nslabs;
+
+        // Thread back to front, so cells go out in address order
+        for( size_t x = CELLS_PER_SLAB; x > 0; --x ){
+            auto cell = reinterpret_cast<free_cell *>(base + (x - 1) * CELL_SIZE);
+            cell->next = free_list;
+            free_list = cell;
+        }
+    }
+
+    free_cell * _Nullable free_list = nullptr;
+    size_t nslabs = 0;
+    size_t in_use = 0;
+
+public:
+    /**
+     * Cells freed away from the pool--by another thread, say--linked
+     *	up ready to be handed back with a single release().
+     */
+    struct chain {
+        free_cell * _Nullable head = nullptr;
+        free_cell * _Nullable tail = nullptr;
+        size_t count = 0;
+
+        void add(void * _Nonnull p)
+        {
+            auto cell = static_cast<free_cell *>(p);
+            cell->next = head;
+            if( !head )
+                tail = cell;
+            head = cell;
+            ++count;
+        }
+
+        /// Take a cell off the chain, which mustn't be empty
+        void * _Nonnull pop()
+        {
+            auto cell = head;
+            head = cell->next;
+            if( !head )
+                tail = nullptr;
+            --count;
+            return cell;
+        }
+    };
+};
+
+#endif
@@ -5,6 +5,7 @@
  */
 #include <string.h>
 #include "fpcommon.h"
+#include "intrin.h"
 #include "misc.h"
 #include "symtab.h"
 #include "yystype.h"
@@ -86,46 +87,8 @@ stuff(const char *sym, int val)
 /// Fill in symbol table with built-ins
 void
 symtab_init(void){
-    stuff( "and", AND );
-    stuff( "or", OR );
-    stuff( "xor", XOR );
-    stuff( "sin", SIN );
-    stuff( "cos", COS );
-    stuff( "tan", TAN );
-    stuff( "asin", ASIN );
-    stuff( "acos", ACOS );
-    stuff( "atan", ATAN );
-    stuff( "log", LOG );
-    stuff( "exp", EXP );
-    stuff( "mod", MOD );
-    stuff( "concat", CONCAT );
-    stuff( "last", LAST );
-    stuff( "first", FIRST );
-    stuff( "tl", TL );
-    stuff( "hd", HD );
-    stuff( "id", ID );
-    stuff( "atom", ATOM );
-    stuff( "eq", EQ );
-    stuff( "not", NOT );
-    stuff( "null", NIL );
-    stuff( "reverse", REVERSE );
-    stuff( "distl", DISTL );
-    stuff( "distr", DISTR );
-    stuff( "length", LENGTH );
-    stuff( "trans", TRANS );
-    stuff( "apndl", APNDL );
-    stuff( "apndr", APNDR );
-    stuff( "tlr", TLR );
-    stuff( "front", FRONT );
-    stuff( "rotl", ROTL );
-    stuff( "rotr", ROTR );
-    stuff( "iota", IOTA );
-    stuff( "pair", PAIR );
-    stuff( "split", SPLIT );
-    stuff( "out", OUT );
     stuff( "while", WHILE );
-    stuff( "pick", PICK );
-    stuff( "div", DIV );
     stuff( "T", T );
     stuff( "F", F );
+    intrin_init();
 }
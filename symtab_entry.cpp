@@ -1,9 +1,120 @@
 #include <stdio.h>
+#include <algorithm>
 #include "fpcommon.h"
 #include "ast.h"
+#include "intrin.h"
+#include "memo.h"
 #include "misc.h"
+#include "optimize.h"
+#include "vm.h"
 #include "yystype.h"
+#include "ast.hpp"
 #include "symtab_entry.hpp"
+#include "y.tab.h"
+
+    /*
+     * A definition calls other functions by name, so redefining one of
+     *	them changes what it does only through what was spliced into its
+     *	body.  Each function knows which functions call it; redefining
+     *	one drops the bodies and bytecode of everything that calls it,
+     *	directly or not, and each is built again when next called.
+     *	Loading a library thus compiles only what gets run.  The results
+     *	any of them kept under )memo go too.
+     */
+
+#ifdef MEMSTAT
+extern int obj_out, ast_out;
+#endif
+
+    /*
+     * Bodies and bytecode are built and dropped behind the user's back,
+     *	often while some application runs; leave them out of the counts
+     *	MEMSTAT keeps for it.
+     */
+struct uncounted final {
+#ifdef MEMSTAT
+    const int objs = obj_out;
+    const int asts = ast_out;
+#endif
+
+    ~uncounted()
+    {
+#ifdef MEMSTAT
+        obj_out = objs;
+        ast_out = asts;
+#endif
+    }
+};
+
+/// Add the 'U' references in act to calls, once each
+static void
+find_calls(ast_ptr act, std::vector<sym_ptr> &calls)
+{
+    if( !act )
+        return;
+    if( act->tag == 'U' ){
+        if( std::find(calls.begin(), calls.end(), act->val.YYsym) == calls.end() )
+            calls.push_back(act->val.YYsym);
+        return;
+    }
+    find_calls(act->left, calls);
+    find_calls(act->middle, calls);
+    find_calls(act->right, calls);
+}
+
+/// Remove sym from v, if it is there
+static void
+forget(std::vector<sym_ptr> &v, sym_ptr sym)
+{
+    auto at = std::find(v.begin(), v.end(), sym);
+    if( at != v.end() )
+        v.erase(at);
+}
+
+void symtab_entry::compile()
+{
+    assert(is_defined());
+    uncounted quiet;
+    sym_inlined.clear();
+    sym_body = opt_inline(this);
+    sym_code = vm_compile(static_cast<live_ast_ptr>(sym_body ? sym_body : sym_val.YYast));
+}
+
+void symtab_entry::link_calls()
+{
+    for( auto callee: sym_calls )
+        forget(callee->sym_users, this);
+    sym_calls.clear();
+    if( is_defined() )
+        find_calls(sym_val.YYast, sym_calls);
+    for( auto callee: sym_calls ){
+        if( std::find(callee->sym_users.begin(), callee->sym_users.end(), this) == callee->sym_users.end() )
+            callee->sym_users.push_back(this);
+    }
+}
+
+void symtab_entry::invalidate_users()
+{
+    uncounted quiet;
+    std::vector<sym_ptr> todo = sym_users;
+    std::vector<sym_ptr> seen{this};
+    while( !todo.empty() ){
+        auto user = todo.back();
+        todo.pop_back();
+        if( std::find(seen.begin(), seen.end(), user) != seen.end() )
+            continue;
+        seen.push_back(user);
+        vm_free(user->sym_code);
+        user->sym_code = nullptr;
+        ast_freetree(user->sym_body);
+        user->sym_body = nullptr;
+        user->sym_inlined.clear();
+        user->sym_par_known = false;
+        user->sym_silent_known = false;
+        memo_flush(static_cast<live_sym_ptr>(user));
+        todo.insert(todo.end(), user->sym_users.begin(), user->sym_users.end());
+    }
+}
 
 /// Define a function
 void symtab_entry::define(live_ast_ptr def)
@@ -13,6 +124,13 @@ void symtab_entry::define(live_ast_ptr def)
     switch( type() ){
         case symtype::SYM_DEF:
             printf("%s: redefined.\n", sym_pname.c_str());
+            {
+                uncounted quiet;
+                vm_free(sym_code);
+                sym_code = nullptr;
+                ast_freetree(sym_body);
+                sym_body = nullptr;
+            }
             ast_freetree(sym_val.YYast);
             break;
         case symtype::SYM_NEW:
@@ -26,8 +144,93 @@ void symtab_entry::define(live_ast_ptr def)
      * Mark symbol as a user-defined function, attach its
      *    definition.
      */
+    def = opt_rewrite(def);
     sym_val.YYast = def;
     type(symtype::SYM_DEF);
+    sym_par_known = false;
+    sym_silent_known = false;
+    memo_flush(this);
+    link_calls();
+    invalidate_users();
+    compile();
+}
+
+live_ast_ptr symtab_entry::body()
+{
+    assert(is_defined());
+    if( !sym_code )
+        compile();
+    return static_cast<live_ast_ptr>(sym_body ? sym_body : sym_val.YYast);
+}
+
+/// Tell if act may print something
+static bool
+prints(ast_ptr act)
+{
+    if( !act )
+        return(false);
+    if( act->tag == 'i' && intrin_prints(act->val.YYsym) )
+        return(true);
+    return prints(act->left) || prints(act->middle) || prints(act->right);
+}
+
+    /*
+     * top and everything it calls, at any depth; or nothing, if any of
+     *	them is undefined or prints.
+     */
+static std::vector<sym_ptr>
+silent_calls(sym_ptr top)
+{
+    std::vector<sym_ptr> todo{top};
+    std::vector<sym_ptr> seen;
+    while( !todo.empty() ){
+        auto def = todo.back();
+        todo.pop_back();
+        if( std::find(seen.begin(), seen.end(), def) != seen.end() )
+            continue;
+        if( !def->is_defined() || prints(def->sym_val.YYast) )
+            return {};
+        seen.push_back(def);
+        todo.insert(todo.end(), def->sym_calls.begin(), def->sym_calls.end());
+    }
+    return(seen);
+}
+
+bool symtab_entry::silent()
+{
+    if( sym_silent_known )
+        return(sym_silent);
+    auto seen = silent_calls(this);
+    for( auto def: seen ){
+        def->sym_silent_known = true;
+        def->sym_silent = true;
+    }
+    sym_silent_known = true;
+    sym_silent = !seen.empty();
+    return(sym_silent);
+}
+
+    /*
+     * par.cpp may apply a function on several threads at once if it is
+     *	silent().  All it calls are compiled here, so no thread need do it
+     *	while the others run.
+     */
+bool symtab_entry::parallel_ok()
+{
+    if( sym_par_known )
+        return(sym_par_ok);
+    auto seen = silent_calls(this);
+
+	// All it calls are fine too, if it is; so the threads need never
+	// work any of them out while the others look
+    for( auto def: seen ){
+        def->code();
+        def->sym_par_known = true;
+        def->sym_par_ok = true;
+    }
+    sym_par_known = true;
+    sym_par_ok = !seen.empty();
+    return(sym_par_ok);
 }
 
 bool symtab_entry::is_defined() const
@@ -4,12 +4,35 @@
 #include "symtype.hpp"
 
 #include <string>
+#include <vector>
 
 /// A symbol table entry for an identifier
 struct symtab_entry final {
     symtype sym_type;
     YYstype sym_val{};
     sym_ptr sym_next = nullptr;
+    /// What runs a builtin, if it is an intrinsic
+    intrinsic_fn sym_fn = nullptr;
+    /// The definition with small functions it calls spliced in, if any were
+    ast_ptr sym_body = nullptr;
+    /// The functions spliced into sym_body, at any depth
+    std::vector<sym_ptr> sym_inlined;
+    /// The functions the definition calls
+    std::vector<sym_ptr> sym_calls;
+    /// The functions whose definitions call this one
+    std::vector<sym_ptr> sym_users;
+    /// The results kept by )memo, if any
+    struct memo_cache * _Nullable sym_memo = nullptr;
+    /// A defined function's bytecode; null until it is next needed
+    struct vm_code * _Nullable sym_code = nullptr;
+    /// parallel_ok() has been worked out since anything it depends on changed
+    bool sym_par_known = false;
+    /// What parallel_ok() worked out
+    bool sym_par_ok = false;
+    /// silent() has been worked out since anything it depends on changed
+    bool sym_silent_known = false;
+    /// What silent() worked out
+    bool sym_silent = false;
     const std::string sym_pname;
     
     symtab_entry(const char *pname)
@@ -23,10 +46,31 @@ struct symtab_entry final {
     
     /// Define a function
     void define(live_ast_ptr def);
+    /// What runs when the function is called
+    live_ast_ptr body();
+    /// The function's bytecode
+    struct vm_code * _Nonnull code()
+    {
+        if( !sym_code )
+            compile();
+        return(sym_code);
+    }
+    /// true if the function may run on several threads at once
+    bool parallel_ok();
+    /// true if the function, and all it calls, are defined and print nothing
+    bool silent();
     bool is_defined() const;
     bool is_builtin() const;
     symtype type() const;
     void type(symtype new_type);
+    /// Drop the body and bytecode of everything which calls this
+    void invalidate_users();
+
+private:
+    /// Build the body and bytecode from the definition
+    void compile();
+    /// Keep sym_calls, and the sym_users of what it names, up to date
+    void link_calls();
 };
 
 #endif
@@ -267,3 +267,508 @@ xor:< 1 2 3 >
 {a 2}
 a:<4 5 6>
 {b a@a}
+#
+# Cells taken from the slab pool and given back to it
+#
+)memstat
+length@&[id,%1.5,%T,%<>]@iota:5000
+length@&[id,%1.5,%T,%<>]@iota:5000
+!+@&(+@[id,%0.5])@&id@iota:5000
+&(+@[id,%0.5])@&id@iota:20
+distl@[%<1 2>,iota]:3
+[%<>, %T, %F, %?]:0
+[id, %2.5, %<1 <2>>]:<1 2>
+)memstat
+#
+# Each kind of object in its cell
+#
+id:<1 -1 0 2147483647 -2147483647 0.5 -2.25 1000000.5 T F <> <<>> <1 <2 <3>>>>
+&id:<1 -1 0 0.5 -2.25 T F <> <<>> <1 <2 <3>>>>
+&atom:<1 1.5 T F <> <1>>
+&null:<<> <1> 1>
+&length:<<> <1> <1 2>>
+[hd, tl, last, tlr]:<1 2.5 T <3>>
++:<2147483647 1>
+-:<-2147483647 2>
+*:<1.5 2>
++:<1 0.5>
+/:<1 4>
+=:<1 1.0>
+=:<<1 2.5 T> <1 2.5 T>>
+=:<<1 2.5 T> <1 2.5 F>>
+apndl:<0.25 <T <>>>
+#
+# T, F, ?, <> and small integers are shared, and still behave
+#
+[%T, %T, %F, %F, %<>, %<>]:0
+&null:<<> <> <1>>
+&atom:<T F <> 0>
+&not:<T F>
+[=, <, >]:<1023 1023>
+[=, <, >]:<1024 1024>
+[=, <, >]:<-128 -128>
+[=, <, >]:<-129 -129>
+=:<1023 1023.0>
+=:<1024 1024.0>
+=:<-129 -129.0>
++:<1022 1>
++:<1023 1>
+-:<-127 1>
+-:<-128 1>
+&(+@[id,%1019])@iota:6
+&(-@[%-124,id])@iota:6
+length@iota:1023
+length@iota:1024
+1023@iota:1024
+last@iota:1024
+!+@&(mod@[id,%1100])@iota:5000
+length@concat@&(<@[id,%500] -> [id] ; %<>)@iota:5000
+{big %1024}
+{small %1023}
+[small, big, small, big]:0
+last@&(=@[id,%1023])@iota:1023
+!or@&(=@[id,%1024])@iota:1023
+!or@&(=@[id,%1024])@iota:1024
+#
+# Lists of eight or more elements are kept in arrays
+#
+&id@iota:20
+tl@iota:9
+tl@tl@&[id]@iota:10
+9:<1 2 3 4 5 6 7 8 9 10>
+11:<1 2 3 4 5 6 7 8 9 10>
+length:<1 2 3 4 5 6 7 8 9 10>
+apndl:<0 <1 2 3 4 5 6 7 8 9>>
+apndr:<<1 2 3 4 5 6 7 8 9> 10>
+reverse:<1 2 3 4 5 6 7 8 9 10>
+rotl:<1 2 3 4 5 6 7 8 9 10>
+rotr:<1 2 3 4 5 6 7 8 9 10>
+tlr:<1 2 3 4 5 6 7 8 9 10>
+concat:<<1 2 3 4 5> <6 7 8 9 10> <> <11>>
+distl:<0 <1 2 3 4 5 6 7 8 9>>
+distr:<<1 2 3 4 5 6 7 8 9> 0>
+split:<1 2 3 4 5 6 7 8 9>
+pair:<1 2 3 4 5 6 7 8 9 10>
+=:<<1 2 3 4 5 6 7 8 9> <1 2 3 4 5 6 7 8 9>>
+=@[&id@iota,%<1 2 3 4 5 6 7 8 9>]:9
+#
+# All-int and all-float arrays are kept unboxed
+#
+!+@iota:100
+|+@iota:100
+!-@iota:9
+|-@iota:9
+!*:<1.5 2.0 2.5 3.0 3.5 4.0 4.5 5.0>
+!+:<1 2 3 4 5 6 7 8 9.5>
+!+:<1 2 3 4 5 6 7 8 T>
+!+:<2147483647 1 1 1 1 1 1 1 1>
+&+@trans:<<1 2 3 4 5 6 7 8 9> <9 8 7 6 5 4 3 2 1>>
+&*@distl:<2 <1 2 3 4 5 6 7 8 9>>
+&-@distr:<<1 2 3 4 5 6 7 8 9> 0.5>
+&/@distr:<<1 2 3 4 5 6 7 8 9> 0>
+&/@trans:<<1 2 3 4 5 6 7 8 9> <1 1 1 1 0 1 1 1 1>>
+&+@trans:<<1 2 3 4 5 6 7 8 9> <1 2 3>>
+&sin@&(*@[id,%0.5])@iota:9
+&exp:<1 2 3 4 5 6 7 8 T>
+apndr:<<1 2 3 4 5 6 7 8 9> 1.5>
+apndl:<T <1 2 3 4 5 6 7 8 9>>
+#
+# Freeing a very long list, and a very deeply nested one
+#
+length@iota:10000000
+length@&[id]@iota:10000000
+length@2@(while (>@[1,%0]) [-@[1,%1], [2]])@[id,%<>]:1000000
+length@2@(while (>@[1,%0]) [-@[1,%1], [1,2]])@[id,%<>]:1000000
+#
+# Big lists freed on the background thread
+#
+)bgfree
+length@&id@iota:200000
+!+@&(+@[id,%0.5])@iota:100000
+length@concat@[&id@iota,&id@iota]:100000
+)bgfree
+length@&id@iota:200000
+#
+# A list nobody else holds is changed in place; one that is shared is not
+#
+[apndr, 1]:<<1 2 3 4 5 6 7 8 9> 10>
+[reverse, id]:<1 2 3 4 5 6 7 8 9>
+[rotl, id, rotr]:<1 2 3 4 5 6 7 8 9>
+[tlr, id]:<1 2 3>
+[concat, 1]:<<1 2 3 4 5 6 7 8 9> <10 11>>
+reverse@reverse@&id@iota:12
+rotr@rotl@apndr@[&id@iota, %0]:9
+{nine %<1 2 3 4 5 6 7 8 9>}
+apndr@[nine,%10]:0
+apndr@[nine,%10]:0
+reverse@nine:0
+nine:0
+)vm
+[out@tl, out]:<1 2>
+[out, 3]:<1 2>
+{outtl out@tl}
+[outtl, out]:<1 2>
+[outtl, 3]:<1 2>
+[outtl, 1]:<<1 2> 3>
+{outtl id}
+[outtl, 1]:<<1 2> 3>
+)vm
+#
+# Equality, with the hashes lists keep of themselves
+#
+=:<<1 2 3> <1 2 3>>
+=:<<1 2 3> <1 2 4>>
+=:<<1 2> <1.0 2.0>>
+=:<<1 <2 3>> <1 <2 3>>>
+=:<<1 <2 3>> <1 <2 4>>>
+=@[id,id]@&id@iota:100
+=@[id,reverse@reverse]@&[id]@iota:100
+=@[id,rotl]@&id@iota:100
+eq:<<1 2 3 4 5 6 7 8 9> <1 2 3 4 5 6 7 8 9.0>>
+#
+# Each application's objects from an arena
+#
+)arena
+length@&[id]@iota:1000
+!+@&(*@[id,%0.5])@iota:100
+[id, reverse]:<1 2 3>
+{kept %<1 2 3>}
+kept:0
+(1 -> 2 ; %?):<F 1 2>
+)arena
+kept:0
+#
+# The bytecode VM and the tree walker give the same answers
+#
+{fact (=@[id,%0] -> %1 ; *@[id,fact@-@[id,%1]])}
+{cnt (while (>@[id,%0]) -@[id,%1])}
+fact:10
+cnt:100
+&fact@iota:6
+[hd, tl, length]:<1 2 3>
+(null -> %? ; hd):<>
+)vm
+fact:10
+cnt:100
+&fact@iota:6
+[hd, tl, length]:<1 2 3>
+(null -> %? ; hd):<>
+)vm
+[out@tl, out]:<1 2>
+[out, 3]:<1 2>
+{outtl2 out@tl}
+[outtl2, out]:<1 2>
+[outtl2, 3]:<1 2>
+{outtl2 id}
+[outtl2, 3]:<1 2>
+{outtl2 out@tl}
+[outtl2, 3]:<1 2>
+#
+# Calls in tail position don't nest
+#
+{down (=@[id,%0] -> %0 ; down@-@[id,%1])}
+{odd1 (=@[id,%0] -> %F ; even1@-@[id,%1])}
+{even1 (=@[id,%0] -> %T ; odd1@-@[id,%1])}
+down:1000000
+even1:100001
+)vm
+down:1000000
+even1:100001
+)vm
+#
+# Recursion too deep gives ?
+#
+{sum (null -> %0 ; +@[hd, sum@tl])}
+)depth
+)depth 50
+sum@iota:40
+sum@iota:60
+[sum, length]@iota:60
+sum@iota:40
+)depth 10000000
+sum@iota:60
+)vm
+sum@iota:1000000
+sum@iota:40
+)vm
+#
+# The rewriter's laws must not change what a function gives
+#
+&(+@[id,%1])@&(*@[id,%2]):<1 2 3>
+1@tl@tl:<1 2 3 4>
+2@tl@tl@tl:<1 2 3 4>
+tl@tl@tl:<1 2>
+[hd@tl, 2@tl]:<1 2 3>
+(%T -> %1 ; %?):5
+(%F -> %? ; %2):5
+(1@tl -> 2@tl ; 3@tl):<0 T 4 5>
+(1@tl -> 2@tl ; 3@tl):<0 1 4 5>
++@[%1,%2]:?
++@[%1,%2]:7
+[%1,%2]:7
+[%1,%?]:7
+2@[hd,%3]:<>
+2@[id,%3]:?
+)opt
+1@[id,%?]:5
+[1@out,2@out]:<7 8>
+1@tl@tl:<1 2 3 4>
+)opt
+1@[id,%?]:5
+&(1@[id,%?]):<1 2>
+2@[%?,id]:5
+1@[id,%3]:5
+[1@out,2@out]:<7 8>
+(1@out -> 2@out ; 3@out):<T 4 5>
+[1@tl,2@tl]:<7 8 9>
+&[out]@&[out]:<1 2>
+&(/@[%1,id])@&out:<1 0 2>
+{outg out}
+&outg@&outg:<1 2>
+&(/@[%1,id])@&outg:<1 0 2>
+#
+# Maps, filters and reductions streamed one element at a time
+#
+{even2 =@[mod@[id,%2],%0]}
+&(+@[id,%1])@&(*@[id,%2])@iota:9
+!+@&(*@[id,id])@iota:100
+|+@&(*@[id,id])@iota:100
+length@&(*@[id,id])@iota:100
+concat@&(even2 -> [id] ; %<>)@iota:20
+concat@&(even2 -> [*@[id,%10]] ; %<>)@iota:20
+!+@concat@&(even2 -> [id] ; %<>)@iota:20
+concat@&(even2 -> [id] ; %<>):<1 2 T 4>
+&(/@[%1,id])@&(-@[id,%3])@iota:5
+!+@&(/@[%6,id])@&(-@[id,%3])@iota:5
+!+@&(+@[id,%0.5]):<>
+&out@&(*@[id,%2]):<1 2 3>
+length@&out:<1 2 3>
+!+@&out:<1 2 3>
+!+@&(*@[1,2])@distl:<2 <1 2 3>>
+!+@&(*@[1,2])@distr:<<1 2 3> 2>
+{quiet1 id}
+{twice1 !+@&quiet1@&quiet1}
+twice1:<1 2>
+{quiet1 out}
+twice1:<1 2>
+length@&quiet1@&quiet1:<1 2>
+concat@&(quiet1 -> [quiet1] ; %<>)@&quiet1:<T F>
+|+@&quiet1@&(+@[id,%1])@iota:3
+#
+# Small functions spliced into their callers, and what follows a redefinition
+#
+{sq *@[id,id]}
+{sqs &sq}
+{sumsq !+@sqs}
+sqs:<1 2 3>
+sumsq:<1 2 3>
+{sq +@[id,id]}
+sqs:<1 2 3>
+sumsq:<1 2 3>
+{sq out}
+sqs:<1 2 3>
+#
+# Calling a function not yet defined, then defining it
+#
+{later1 notyet@tl}
+later1:<1 2 3 4>
+{notyet hd}
+later1:<1 2 3 4>
+{notyet length}
+later1:<1 2 3 4>
+)vm
+later1:<1 2 3 4>
+)vm
+#
+# Keeping the results of a function
+#
+{fib (<@[id,%2] -> id ; +@[fib@-@[id,%1], fib@-@[id,%2]])}
+{plus1 +@[id,%1]}
+{viap plus1@id}
+)memo fib
+)memo viap
+fib:25
+fib:25
+fib:?
+viap:5
+)memo
+{plus1 +@[id,%2]}
+viap:5
+{fib %0}
+fib:25
+)memo fib
+)memo viap
+)memo
+)memo id
+)memo nosuch
+#
+# Apply-to-all spread over threads
+#
+)par 4
+{pfib (<@[id,%2] -> id ; +@[pfib@-@[id,%1], pfib@-@[id,%2]])}
+{pfact (=@[id,%0] -> %1 ; *@[id,pfact@-@[id,%1]])}
+&pfib@iota:20
+&(*@[id,id])@&id@iota:2000
+length@&(+@[id,%0.5])@&id@iota:100000
+&(/@[%1,id])@&(-@[id,%500])@&id@iota:1000
+&out:<1 2 3>
+&pfact@&(-@[%20,id])@iota:10
+)par 1
+&pfib@iota:20
+#
+# Constructions and binary inserts forked onto the threads
+#
+)par 4
+[pfib, pfib@-@[id,%1], pfib@-@[id,%2]]:22
+[pfib, %?]:20
+[1@out, 2@out]:<1 2>
+|+@&pfib@iota:22
+|concat@&[id]@&id@iota:5000
+length@|concat@&[id]@&id@iota:100000
+|-@&id@iota:10000
+|/@&(-@[id,%5000])@&id@iota:10000
+)par 1
+)par 4
+[out@tl, out@tl@tl, out]:<1 2 3>
+{outtl3 out@tl}
+[outtl3, outtl3@tl, pfib]:<20 21 22>
+[pfib@1, pfib@2, outtl3]:<20 21 22>
+)par 1
+#
+# iota's list is only written out if something needs it
+#
+iota:0
+iota:1
+iota:1.5
+length@iota:10000000
+last@iota:100000
+7@iota:9
+10@iota:9
+hd@tl@iota:9
+!+@iota:100000
+|+@iota:100000
+!-@iota:9
+|-@iota:9
+!*@iota:12
+&(*@[id,%2])@iota:9
+distl@[%0,iota]:9
+distr@[iota,%0]:9
+reverse@iota:9
+apndr@[iota,%0]:9
+apndl@[%0,iota]:9
+rotl@iota:9
+tlr@iota:9
+=@[iota,&id@iota]:9
+=@[iota,%<1 2 3 4 5 6 7 8 9>]:9
+concat@[iota,iota]:9
+trans@[iota,iota]:9
+!id@iota:3
+|id@iota:3
+[iota, iota@length@iota]:9
+#
+# Intrinsics run the same wherever they are called from
+#
+&length:<<1> <1 2> <>>
+&reverse@&iota:<3 4>
+&(atom -> id ; length):<1 <2 3> T>
+(null -> %0 ; hd):<>
+{hdtl hd@tl}
+hdtl:<1 2 3>
+)vm
+&length:<<1> <1 2> <>>
+&(atom -> id ; length):<1 <2 3> T>
+hdtl:<1 2 3>
+)vm
+mod:<7 3>
+mod:<-7 3>
+mod:<7 0>
+mod:<7.5 2>
+mod:<1 T>
+div:<7 2>
+div:<-7 2>
+div:<7 0>
+div:<7.9 2>
+div:<1>
+#
+# Inner and matrix products, as written and on the fast kernels
+#
+{ip !+@&*@trans}
+{ipb |+@&*@trans}
+{vxm !(&+@trans)@&(&*@distl)@trans}
+{rowsl &ip@distl}
+{rowsr &ip@distr}
+{mm &&ip@&distl@distr@[1,trans@2]}
+ip:<<1 2 3> <4 5 6>>
+ip:<<1 2 3 4 5 6 7 8 9 10> <1 2 3 4 5 6 7 8 9 10>>
+ip:<<0.5 1.5 2.5 3.5 4.5 5.5 6.5 7.5 8.5> <1 2 3 4 5 6 7 8 9>>
+ipb:<<0.1 0.2 0.3 0.4 0.5 0.6 0.7 0.8 0.9> <1.7 1.9 2.3 2.9 3.1 3.7 4.1 4.3 4.7>>
+ip:<<1 2> <1 2 3>>
+ip:<<1 2.0> <1 2>>
+ip:<<1 T> <1 2>>
+ip:<<> <>>
+ip:<1 2>
+ip@[iota,iota]:100000
+ip:<<2147483647 2147483647 2147483647 2147483647 2147483647 2147483647 2147483647 2147483647 2147483647> <3 3 3 3 3 3 3 3 3>>
+vxm:<<1 2> <<1 2 3> <4 5 6>>>
+vxm:<<1.5 2> <<1 2 3> <4 5 6>>>
+vxm:<<1 2> <<1 2 3> <4 5>>>
+vxm:<<1 2 3> <<1 2 3> <4 5 6>>>
+rowsl:<<1 2> <<1 2> <3 4> <5 6>>>
+rowsr:<<<1 2> <3 4> <5 6>> <1 2>>
+rowsl:<<1 2> <<1 2> <3.5 4> <5 6>>>
+rowsl:<<1 2> <<1 2> <3.5 4.5> <5 6>>>
+rowsl:<<1 2> <<1 2> <3 4 5> <5 6>>>
+mm:<<<1 2> <3 4>> <<5 6> <7 8>>>
+mm:<<<1 2 3> <4 5 6>> <<1 2> <3 4> <5 6>>>
+mm:<<<0.1 2 3> <4 5 6>> <<1 2> <3 4> <5 6>>>
+mm:<<<0.1 0.2 0.3> <0.4 0.5 0.6>> <<0.3 0.7> <1.1 1.3> <1.7 1.9>>>
+mm:<<<1 2> <3 4>> <<5 6> <7 8> <9 10>>>
+mm:<<<1 2> <3 4>> <5 6>>
+mm@[&iota@&%9@iota, &iota@&%9@iota]:9
+!+@&(!+)@mm@[&(&(/@[id,%3.0])@iota)@&%40@iota, &(&(/@[id,%7.0])@iota)@&%40@iota]:40
+#
+# trans of ragged, short, long and unboxed matrices
+#
+trans:<<1 2> <4 5 6>>
+trans:<<> <1>>
+trans:<<1> <>>
+trans:<<1 2> 3>
+trans:<3 <1 2>>
+trans:<<1 2>>
+trans:<<1> <2> <3>>
+trans@&iota@&%9@iota:9
+trans@&(&(/@[id,%3.0])@iota)@&%9@iota:8
+trans@trans@&iota@&%9@iota:9
+trans@&iota@&%3@iota:10
+trans@&iota@iota:9
+tl@trans@&iota@&%9@iota:9
+&(!+)@trans@&iota@&%9@iota:9
+!+@&(!+)@trans@&iota@&%300@iota:300
+#
+# ! and | with functions of the user's own
+#
+{sub2 -@[1,2]}
+{swap [2,1]}
+{catb concat@[1,2]}
+!sub2:<1 2 3 4 5 6 7 8 9 10 11 12>
+|sub2:<1 2 3 4 5 6 7 8 9 10 11 12>
+!sub2@iota:20
+|sub2@iota:20
+!swap:<1 2 3 4>
+|swap@iota:9
+|swap:<1 2 3 4 5 6 7 8 9 10 11>
+!1@iota:30
+!2@iota:30
+!id:<1 2 3 4>
+!id@iota:5
+!catb:<<1> <2 3> <4> <5 6> <7> <8> <9> <10> <11>>
+|catb:<<1> <2 3> <4> <5 6> <7> <8> <9> <10> <11>>
+!sub2:<1 2 T 4 5 6 7 8 9 10 11 12>
+|sub2:<1 2 T 4 5 6 7 8 9 10 11 12>
+!sub2:<5>
+|sub2:<5 6>
+|swap@apndl@[%0,iota]:12
+|sub2@apndl@[%0,iota]:3000
+!sub2@apndl@[%0,iota]:3000
+length@!apndl@apndr@[&[id]@iota,%<>]:300
+!+@&(+@[id,%0.5])@iota:1000000
@@ -10,4 +10,7 @@ typedef struct object * _Nonnull live_obj_ptr;
 typedef struct symtab_entry * _Nullable sym_ptr;
 typedef struct symtab_entry * _Nonnull live_sym_ptr;
 
+/// What runs an intrinsic: it takes its argument's reference, and gives one
+typedef live_obj_ptr (* _Nullable intrinsic_fn)(live_obj_ptr obj);
+
 #endif
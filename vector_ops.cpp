@@ -0,0 +1,936 @@
+/*
+ * vector_ops.cpp--numeric kernels over unboxed vectors
+ *
+ *	The interpreter recognizes a few idioms (!+, &*@distl and the
+ *	like) and, when their arguments are unboxed vectors, hands them
+ *	here instead of building a pair object for every element.  Each
+ *	entry point returns null, leaving its argument alone, if it can't
+ *	do the job; the caller then runs the idiom the ordinary way.
+ */
+#include <algorithm>
+#include <climits>
+#include <vector>
+#include "fpcommon.h"
+#include "yystype.h"
+#include "ast.hpp"
+#include "misc.h"
+#include "obj.h"
+#include "object.hpp"
+#include "idiom.hpp"
+#include "list_builder.hpp"
+#include "list_iter.hpp"
+#include "symtab_entry.hpp"
+#include "vector_ops.h"
+#include "y.tab.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+    /*
+     * Integer arithmetic is done unsigned, so that overflow wraps the way
+     *	it always has in practice, without being undefined behaviour.
+     *	Wrapped sums and products don't care about order, which is what
+     *	lets us reduce ints in SIMD lanes.
+     */
+static int
+int_op(int op, int a, int b)
+{
+    const auto ua = static_cast<unsigned>(a);
+    const auto ub = static_cast<unsigned>(b);
+    switch( op ){
+    case '+':
+        return static_cast<int>(ua + ub);
+    case '-':
+        return static_cast<int>(ua - ub);
+    case '*':
+        return static_cast<int>(ua * ub);
+    }
+    fatal_err("Bad int op in int_op()");
+}
+
+static double
+double_op(int op, double a, double b)
+{
+    switch( op ){
+    case '+':
+        return a + b;
+    case '-':
+        return a - b;
+    case '*':
+        return a * b;
+    case '/':
+        return a / b;
+    }
+    fatal_err("Bad double op in double_op()");
+}
+
+    /*
+     * SIMD lanes for each element type.  Whatever the target offers is
+     *	used; with neither AVX2 nor SSE2 a lane is just one element.
+     */
+#if defined(__AVX2__)
+
+struct int_lanes {
+    using reg = __m256i;
+    static constexpr unsigned width = 8;
+    static reg load(const int *p)
+    {
+        return _mm256_loadu_si256(reinterpret_cast<const reg *>(p));
+    }
+    static void store(int *p, reg r)
+    {
+        _mm256_storeu_si256(reinterpret_cast<reg *>(p), r);
+    }
+    static reg splat(int v)
+    {
+        return _mm256_set1_epi32(v);
+    }
+    static reg apply(int op, reg a, reg b)
+    {
+        switch( op ){
+        case '+':
+            return _mm256_add_epi32(a, b);
+        case '-':
+            return _mm256_sub_epi32(a, b);
+        default:
+            return _mm256_mullo_epi32(a, b);
+        }
+    }
+};
+
+struct double_lanes {
+    using reg = __m256d;
+    static constexpr unsigned width = 4;
+    static reg load(const double *p)
+    {
+        return _mm256_loadu_pd(p);
+    }
+    static void store(double *p, reg r)
+    {
+        _mm256_storeu_pd(p, r);
+    }
+    static reg splat(double v)
+    {
+        return _mm256_set1_pd(v);
+    }
+    static reg apply(int op, reg a, reg b)
+    {
+        switch( op ){
+        case '+':
+            return _mm256_add_pd(a, b);
+        case '-':
+            return _mm256_sub_pd(a, b);
+        case '*':
+            return _mm256_mul_pd(a, b);
+        default:
+            return _mm256_div_pd(a, b);
+        }
+    }
+};
+
+#elif defined(__SSE2__)
+
+struct int_lanes {
+    using reg = __m128i;
+    static constexpr unsigned width = 4;
+    static reg load(const int *p)
+    {
+        return _mm_loadu_si128(reinterpret_cast<const reg *>(p));
+    }
+    static void store(int *p, reg r)
+    {
+        _mm_storeu_si128(reinterpret_cast<reg *>(p), r);
+    }
+    static reg splat(int v)
+    {
+        return _mm_set1_epi32(v);
+    }
+    static reg apply(int op, reg a, reg b)
+    {
+        switch( op ){
+        case '+':
+            return _mm_add_epi32(a, b);
+        case '-':
+            return _mm_sub_epi32(a, b);
+        default: {
+            // SSE2 has no 32-bit multiply-low; do the even and odd lanes
+            auto even = _mm_mul_epu32(a, b);
+            auto odd = _mm_mul_epu32(_mm_srli_si128(a, 4), _mm_srli_si128(b, 4));
+            return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                                      _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+        }
+        }
+    }
+};
+
+struct double_lanes {
+    using reg = __m128d;
+    static constexpr unsigned width = 2;
+    static reg load(const double *p)
+    {
+        return _mm_loadu_pd(p);
+    }
+    static void store(double *p, reg r)
+    {
+        _mm_storeu_pd(p, r);
+    }
+    static reg splat(double v)
+    {
+        return _mm_set1_pd(v);
+    }
+    static reg apply(int op, reg a, reg b)
+    {
+        switch( op ){
+        case '+':
+            return _mm_add_pd(a, b);
+        case '-':
+            return _mm_sub_pd(a, b);
+        case '*':
+            return _mm_mul_pd(a, b);
+        default:
+            return _mm_div_pd(a, b);
+        }
+    }
+};
+
+#else
+
+struct int_lanes {
+    using reg = int;
+    static constexpr unsigned width = 1;
+    static reg load(const int *p)
+    {
+        return *p;
+    }
+    static void store(int *p, reg r)
+    {
+        *p = r;
+    }
+    static reg splat(int v)
+    {
+        return v;
+    }
+    static reg apply(int op, reg a, reg b)
+    {
+        return int_op(op, a, b);
+    }
+};
+
+struct double_lanes {
+    using reg = double;
+    static constexpr unsigned width = 1;
+    static reg load(const double *p)
+    {
+        return *p;
+    }
+    static void store(double *p, reg r)
+    {
+        *p = r;
+    }
+    static reg splat(double v)
+    {
+        return v;
+    }
+    static reg apply(int op, reg a, reg b)
+    {
+        return double_op(op, a, b);
+    }
+};
+
+#endif
+
+static int
+scalar_op(int op, int a, int b)
+{
+    return int_op(op, a, b);
+}
+
+static double
+scalar_op(int op, double a, double b)
+{
+    return double_op(op, a, b);
+}
+
+/// One side of an elementwise op: a run of numbers, or one number repeated
+template <typename ELEM>
+struct operand {
+    const ELEM *elems;
+    ELEM value;
+    bool splat;
+};
+
+/// out[x] = a[x] op b[x], for x < n
+template <typename LANES, typename ELEM>
+static void
+zip(int op, const operand<ELEM> &a, const operand<ELEM> &b, ELEM *out, unsigned n)
+{
+    const auto sa = LANES::splat(a.value);
+    const auto sb = LANES::splat(b.value);
+    unsigned x = 0;
+    for( ; x + LANES::width <= n; x += LANES::width ){
+        auto ra = a.splat ? sa : LANES::load(a.elems + x);
+        auto rb = b.splat ? sb : LANES::load(b.elems + x);
+        LANES::store(out + x, LANES::apply(op, ra, rb));
+    }
+    for( ; x < n; ++x ){
+        auto va = a.splat ? a.value : a.elems[x];
+        auto vb = b.splat ? b.value : b.elems[x];
+        out[x] = scalar_op(op, va, vb);
+    }
+}
+
+/// Fold + or * over n ints, in whatever order suits the lanes
+static int
+reduce_ints(int op, const int *a, unsigned n)
+{
+    using LANES = int_lanes;
+    unsigned x = 0;
+    int result = (op == '+') ? 0 : 1;
+    if( n >= LANES::width ){
+        auto acc = LANES::load(a);
+        for( x = LANES::width; x + LANES::width <= n; x += LANES::width )
+            acc = LANES::apply(op, acc, LANES::load(a + x));
+        int lanes[LANES::width];
+        LANES::store(lanes, acc);
+        for( auto v : lanes )
+            result = int_op(op, result, v);
+    }
+    for( ; x < n; ++x )
+        result = int_op(op, result, a[x]);
+    return(result);
+}
+
+/// What |op does to a list of n numbers, split the way do_binsert() does
+template <typename ELEM>
+static ELEM
+binsert(int op, const ELEM *a, unsigned n)
+{
+    if( n == 1 )
+        return a[0];
+    const unsigned half = (n + 1) / 2;
+    return scalar_op(op, binsert(op, a, half), binsert(op, a + half, n - half));
+}
+
+/// What !op does to a list of n numbers
+template <typename ELEM>
+static ELEM
+rinsert(int op, const ELEM *a, unsigned n)
+{
+    ELEM acc = a[n - 1];
+    for( unsigned x = n - 1; x > 0; --x )
+        acc = scalar_op(op, a[x - 1], acc);
+    return(acc);
+}
+
+/// What |op does to first, first+1, ... n of them, split the way do_binsert() does
+static int
+range_binsert(int op, int first, unsigned n)
+{
+    if( n == 1 )
+        return(first);
+    const unsigned half = (n + 1) / 2;
+    return int_op(op, range_binsert(op, first, half),
+                  range_binsert(op, int_op('+', first, static_cast<int>(half)), n - half));
+}
+
+    /*
+     * !op or |op over the n ints first, first+1, ... of a range, worked
+     *	out without writing them.  Sums have a closed form; of n and the
+     *	first and last, one of the two is even, so the halving is exact.
+     *	A product of enough ints wraps to 0, and stays there.
+     */
+static int
+range_insert(int op, int first, unsigned n, bool binary)
+{
+    const auto ufirst = static_cast<unsigned>(first);
+    const unsigned ends = ufirst + ufirst + n - 1;
+    switch( op ){
+    case '+':
+        return static_cast<int>((n % 2 == 0) ? (n / 2) * ends : n * (ends / 2));
+    case '*': {
+        unsigned acc = 1;
+        for( unsigned x = 0; x < n && acc; ++x )
+            acc *= ufirst + x;
+        return static_cast<int>(acc);
+    }
+    }
+    if( binary )
+        return range_binsert(op, first, n);
+    int acc = int_op('+', first, static_cast<int>(n - 1));
+    for( unsigned x = n - 1; x > 0; --x )
+        acc = int_op(op, static_cast<int>(ufirst + x - 1), acc);
+    return(acc);
+}
+
+    /*
+     * !+, !*, !- and their | cousins over an unboxed vector.  Float
+     *	results must come out bit-for-bit as before, so floats are
+     *	folded in the same order the tree walker would use; ints can be
+     *	summed or multiplied in any order, so those go through the lanes.
+     */
+obj_ptr
+vec_insert(live_ast_ptr act, live_obj_ptr obj, bool binary)
+{
+    if( !obj->is_packed() || obj->vec_length() < 2 || act->tag != 'c' )
+        return(nullptr);
+    const int op = act->val.YYint;
+    if( op != '+' && op != '-' && op != '*' )
+        return(nullptr);
+
+    const auto n = obj->vec_length();
+    if( obj->is_range() ){
+        auto result = obj_alloc(range_insert(op, obj->range_elem(0), n, binary));
+        obj_unref(obj);
+        return(result);
+    }
+    const auto store = obj->vec_store();
+    live_obj_ptr result;
+    if( store->kind == store_kind::INTS ){
+        const int *a = store->ints() + obj->vec_offset();
+        if( op != '-' )
+            result = obj_alloc(reduce_ints(op, a, n));
+        else if( binary )
+            result = obj_alloc(binsert(op, a, n));
+        else
+            result = obj_alloc(rinsert(op, a, n));
+    } else {
+        const double *a = store->doubles() + obj->vec_offset();
+        if( binary )
+            result = obj_alloc(binsert(op, a, n));
+        else
+            result = obj_alloc(rinsert(op, a, n));
+    }
+    obj_unref(obj);
+    return(result);
+}
+
+/// One side of an int op; the caller has checked it's all ints
+static operand<int>
+int_operand(obj_ptr p)
+{
+    if( p->is_int() )
+        return {nullptr, p->int_val(), true};
+    return {p->vec_store()->ints() + p->vec_offset(), 0, false};
+}
+
+/// One side of a float op, widening ints into spare if need be
+static operand<double>
+double_operand(obj_ptr p, std::vector<double> &spare)
+{
+    if( p->is_num() )
+        return {nullptr, p->num_val(), true};
+    const auto store = p->vec_store();
+    const auto start = p->vec_offset();
+    if( store->kind == store_kind::DOUBLES )
+        return {store->doubles() + start, 0.0, false};
+    spare.assign(store->ints() + start, store->ints() + start + p->vec_length());
+    return {spare.data(), 0.0, false};
+}
+
+/// The token of an intrinsic node, or 0
+static int
+intrinsic_of(live_ast_ptr act)
+{
+    if( act->tag != 'i' )
+        return(0);
+    return act->val.YYsym->sym_val.YYint;
+}
+
+ast_ptr
+vec_map_form(live_ast_ptr act)
+{
+    assert(act->tag == '@');
+    auto map = act->live_left();
+    if( (map->tag != '&') || (map->live_left()->tag != 'c') )
+        return(nullptr);
+    const int op = map->live_left()->val.YYint;
+    if( op != '+' && op != '-' && op != '*' && op != '/' )
+        return(nullptr);
+
+	// a@b@c groups to the right, so the form may head a longer chain
+    live_ast_ptr form = act->live_right();
+    if( form->tag == '@' )
+        form = form->live_left();
+    switch( intrinsic_of(form) ){
+    case TRANS:
+    case DISTL:
+    case DISTR:
+        return(form);
+    default:
+        return(nullptr);
+    }
+}
+
+    /*
+     * &op@trans, &op@distl and &op@distr, when what they would pair up
+     *	comes from unboxed vectors.  Instead of a list of n pairs and a
+     *	charfn call on each, the answer comes from one pass of the lanes.
+     */
+obj_ptr
+vec_map_pair(live_ast_ptr map, live_ast_ptr form, live_obj_ptr obj)
+{
+    assert(map->tag == '&');
+    if( !obj->is_pair() )
+        return(nullptr);
+    const int op = map->live_left()->val.YYint;
+    if( op != '+' && op != '-' && op != '*' && op != '/' )
+        return(nullptr);
+
+	// Each idiom wants a different mix of vectors and numbers
+    auto p = obj->car();
+    auto q = obj->cadr();
+    switch( intrinsic_of(form) ){
+    case TRANS:
+        if( !p->is_packed() || !q->is_packed() )
+            return(nullptr);
+        if( p->vec_length() != q->vec_length() )
+            return(nullptr);
+        break;
+    case DISTL:
+        if( !p->is_num() || !q->is_packed() )
+            return(nullptr);
+        break;
+    case DISTR:
+        if( !p->is_packed() || !q->is_num() )
+            return(nullptr);
+        break;
+    default:
+        return(nullptr);
+    }
+    const auto n = p->is_num() ? q->vec_length() : p->vec_length();
+    if( n < list_builder::VECTOR_MIN )
+        return(nullptr);
+
+	// Ints stay ints, except under / or alongside a float
+    auto is_ints = [](obj_ptr x){
+        return x->is_int() ||
+            (x->is_packed() && x->vec_store()->kind == store_kind::INTS);
+    };
+    vector_store *result;
+    if( op != '/' && is_ints(p) && is_ints(q) ){
+        const auto a = int_operand(p);
+        const auto b = int_operand(q);
+        result = vector_store::create(n, store_kind::INTS);
+        zip<int_lanes>(op, a, b, result->ints(), n);
+    } else {
+        std::vector<double> wa, wb;
+        const auto a = double_operand(p, wa);
+        const auto b = double_operand(q, wb);
+
+            // A zero divisor anywhere makes the whole map undefined
+        if( op == '/' ){
+            for( unsigned x = 0; x < n; ++x ){
+                if( (b.splat ? b.value : b.elems[x]) == 0.0 ){
+                    obj_unref(obj);
+                    return undefined();
+                }
+            }
+        }
+        result = vector_store::create(n, store_kind::DOUBLES);
+        zip<double_lanes>(op, a, b, result->doubles(), n);
+    }
+    result->length = n;
+    obj_unref(obj);
+    return obj_alloc(result, 0, n);
+}
+
+    /*
+     * The linear algebra idioms the rewriter turns into 'V' nodes.  Their
+     *	vectors and matrices may be unboxed or not, but must be all ints
+     *	or all floats; with ints on both sides the answer is in ints, as
+     *	it would be the long way, and otherwise in floats.  Float sums
+     *	are folded in the order the long way would use, so the answer
+     *	comes out bit-for-bit the same; the lanes go across columns.
+     */
+
+/// How the numbers of a list are held, if they are all one kind
+enum class num_kind { NONE, INTS, DOUBLES };
+
+/// Columns a matrix product works on at once, kept in the cache
+static constexpr unsigned COLUMN_BLOCK = 512;
+
+/// The lanes for each element type
+template <typename ELEM> struct lanes_of;
+template <> struct lanes_of<int> { using type = int_lanes; };
+template <> struct lanes_of<double> { using type = double_lanes; };
+
+/// All ints, all floats, or neither; <> and non-lists are neither
+static num_kind
+kind_of(obj_ptr lst)
+{
+    if( !lst->is_list() || lst->is_nil() )
+        return(num_kind::NONE);
+    if( lst->is_range() )
+        return(num_kind::INTS);
+    if( lst->is_packed() )
+        return (lst->vec_store()->kind == store_kind::INTS) ? num_kind::INTS : num_kind::DOUBLES;
+    bool ints = true;
+    bool doubles = true;
+    for( list_iter it{lst}; !it.done() && (ints || doubles); it.next() ){
+        ints = ints && it.elem()->is_int();
+        doubles = doubles && it.elem()->is_float();
+    }
+    return ints ? num_kind::INTS : doubles ? num_kind::DOUBLES : num_kind::NONE;
+}
+
+/// The kind to work in for operands of kinds a and b
+static num_kind
+common(num_kind a, num_kind b)
+{
+    if( a == num_kind::NONE || b == num_kind::NONE )
+        return(num_kind::NONE);
+    return (a == num_kind::INTS && b == num_kind::INTS) ? num_kind::INTS : num_kind::DOUBLES;
+}
+
+    /*
+     * The kind of the rows of matrix m, which must all be of one kind
+     *	and as long as the first; len is set to that.  NONE if m is no
+     *	such matrix.  A row of ints among rows of floats would come out
+     *	ints the long way, so such a matrix is left to it.
+     */
+static num_kind
+rows_kind(obj_ptr m, unsigned &len)
+{
+    if( !m->is_list() || m->is_nil() )
+        return(num_kind::NONE);
+    auto kind = num_kind::NONE;
+    len = 0;
+    for( list_iter it{m}; !it.done(); it.next() ){
+        auto row = it.elem();
+        auto k = kind_of(row);
+        if( k == num_kind::NONE || (kind != num_kind::NONE && k != kind) )
+            return(num_kind::NONE);
+        const auto n = static_cast<unsigned>(row->list_length());
+        if( kind != num_kind::NONE && n != len )
+            return(num_kind::NONE);
+        kind = k;
+        len = n;
+    }
+    return(kind);
+}
+
+/// Unboxed slots of a store, if it holds ELEMs
+static int *
+slots_of(vector_store * _Nonnull store, const int *)
+{
+    return (store->kind == store_kind::INTS) ? store->ints() : nullptr;
+}
+
+static double *
+slots_of(vector_store * _Nonnull store, const double *)
+{
+    return (store->kind == store_kind::DOUBLES) ? store->doubles() : nullptr;
+}
+
+    /*
+     * The numbers of lst as ELEMs, straight out of its store if that
+     *	holds them so, else copied to the end of spare.
+     */
+template <typename ELEM>
+static const ELEM *
+gather(obj_ptr lst, std::vector<ELEM> &spare)
+{
+    if( lst->is_packed() && !lst->is_range() ){
+        if( auto p = slots_of(lst->vec_store(), static_cast<const ELEM *>(nullptr)) )
+            return p + lst->vec_offset();
+    }
+    const auto start = spare.size();
+    if( lst->is_range() ){
+        for( unsigned x = 0; x < lst->vec_length(); ++x )
+            spare.push_back(static_cast<ELEM>(lst->range_elem(x)));
+    } else {
+        for( list_iter it{lst}; !it.done(); it.next() )
+            spare.push_back(static_cast<ELEM>(it.elem()->num_val()));
+    }
+    return spare.data() + start;
+}
+
+/// a·b, n of each, folded from the end as !+@&*@trans does; ints wrap in any order
+static int
+dot(const int *a, const int *b, unsigned n)
+{
+    using LANES = int_lanes;
+    unsigned x = 0;
+    int result = 0;
+    if( n >= LANES::width ){
+        auto acc = LANES::apply('*', LANES::load(a), LANES::load(b));
+        for( x = LANES::width; x + LANES::width <= n; x += LANES::width )
+            acc = LANES::apply('+', acc, LANES::apply('*', LANES::load(a + x), LANES::load(b + x)));
+        int lanes[LANES::width];
+        LANES::store(lanes, acc);
+        for( auto v : lanes )
+            result = int_op('+', result, v);
+    }
+    for( ; x < n; ++x )
+        result = int_op('+', result, int_op('*', a[x], b[x]));
+    return(result);
+}
+
+static double
+dot(const double *a, const double *b, unsigned n)
+{
+    double acc = a[n - 1] * b[n - 1];
+    for( unsigned x = n - 1; x > 0; --x )
+        acc = a[x - 1] * b[x - 1] + acc;
+    return(acc);
+}
+
+/// a·b summed in the order |+ splits the products
+template <typename ELEM>
+static ELEM
+dot_binary(const ELEM *a, const ELEM *b, unsigned n)
+{
+    std::vector<ELEM> products(n);
+    for( unsigned x = 0; x < n; ++x )
+        products[x] = scalar_op('*', a[x], b[x]);
+    return binsert('+', products.data(), n);
+}
+
+    /*
+     * out = a times m, where a has k elements and m is k rows of
+     *	width elements, one after another.  Each column's sum is folded
+     *	from the last row up; a block of columns at a time sits in out
+     *	while the rows of m stream past.
+     */
+template <typename ELEM>
+static void
+vec_mat(const ELEM *a, const ELEM *m, unsigned k, unsigned width, ELEM *out)
+{
+    using LANES = typename lanes_of<ELEM>::type;
+    for( unsigned j0 = 0; j0 < width; j0 += COLUMN_BLOCK ){
+        const unsigned j1 = std::min(width, j0 + COLUMN_BLOCK);
+        for( unsigned x = k; x-- > 0; ){
+            const ELEM *row = m + static_cast<size_t>(x) * width;
+            const auto s = LANES::splat(a[x]);
+            const bool first = (x == k - 1);
+            unsigned j = j0;
+            for( ; j + LANES::width <= j1; j += LANES::width ){
+                auto r = LANES::apply('*', s, LANES::load(row + j));
+                if( !first )
+                    r = LANES::apply('+', r, LANES::load(out + j));
+                LANES::store(out + j, r);
+            }
+            for( ; j < j1; ++j ){
+                auto r = scalar_op('*', a[x], row[j]);
+                out[j] = first ? r : scalar_op('+', r, out[j]);
+            }
+        }
+    }
+}
+
+/// The rows of m, each width long, one after another
+template <typename ELEM>
+static std::vector<ELEM>
+flatten(obj_ptr m, unsigned width)
+{
+    std::vector<ELEM> flat;
+    flat.reserve(static_cast<size_t>(m->list_length()) * width);
+    for( list_iter it{m}; !it.done(); it.next() ){
+        const auto start = flat.size();
+        auto row = gather(it.elem(), flat);
+        if( row != flat.data() + start )
+            flat.insert(flat.end(), row, row + width);
+    }
+    return(flat);
+}
+
+/// a·b, for lists of the same length
+template <typename ELEM>
+static live_obj_ptr
+dot_of(obj_ptr a, obj_ptr b, bool binary)
+{
+    std::vector<ELEM> wa, wb;
+    const auto n = static_cast<unsigned>(a->list_length());
+    auto pa = gather(a, wa);
+    auto pb = gather(b, wb);
+    return obj_alloc(binary ? dot_binary(pa, pb, n) : dot(pa, pb, n));
+}
+
+/// v times each row of m, all as long as v
+template <typename ELEM>
+static live_obj_ptr
+dot_rows(obj_ptr v, obj_ptr m)
+{
+    std::vector<ELEM> wv, wrow;
+    const auto n = static_cast<unsigned>(v->list_length());
+    auto pv = gather(v, wv);
+    list_builder b{static_cast<unsigned>(m->list_length())};
+    for( list_iter it{m}; !it.done(); it.next() ){
+        wrow.clear();
+        b.push(dot(pv, gather(it.elem(), wrow), n));
+    }
+    return(b.finish());
+}
+
+/// The list of width numbers in out
+template <typename ELEM>
+static live_obj_ptr
+row_of(const std::vector<ELEM> &out)
+{
+    list_builder b{static_cast<unsigned>(out.size())};
+    for( auto e: out )
+        b.push(e);
+    return(b.finish());
+}
+
+/// Each row of a (or a itself, if it is a vector) times m, k rows of width
+template <typename ELEM>
+static live_obj_ptr
+times_matrix(obj_ptr a, bool vector, obj_ptr m, unsigned k, unsigned width)
+{
+    const auto flat = flatten<ELEM>(m, width);
+    std::vector<ELEM> wa, out(width);
+    if( vector ){
+        vec_mat(gather(a, wa), flat.data(), k, width, out.data());
+        return row_of(out);
+    }
+    list_builder b{static_cast<unsigned>(a->list_length())};
+    for( list_iter it{a}; !it.done(); it.next() ){
+        wa.clear();
+        vec_mat(gather(it.elem(), wa), flat.data(), k, width, out.data());
+        b.push(row_of(out));
+    }
+    return(b.finish());
+}
+
+obj_ptr
+vec_idiom(live_ast_ptr act, live_obj_ptr obj)
+{
+    assert(act->tag == 'V');
+    if( !obj->is_pair() )
+        return(nullptr);
+    auto p = obj->car();
+    auto q = obj->cadr();
+    const auto which = static_cast<idiom>(act->val.YYint);
+    live_obj_ptr result;
+    switch( which ){
+    case idiom::DOT:
+    case idiom::DOT_BINARY: {
+        const auto kind = common(kind_of(p), kind_of(q));
+        if( kind == num_kind::NONE || p->list_length() != q->list_length() )
+            return(nullptr);
+        const bool binary = (which == idiom::DOT_BINARY);
+        result = (kind == num_kind::INTS) ? dot_of<int>(p, q, binary) : dot_of<double>(p, q, binary);
+        break;
+    }
+    case idiom::DOT_ROWS_LEFT:
+    case idiom::DOT_ROWS_RIGHT: {
+        if( which == idiom::DOT_ROWS_RIGHT )
+            std::swap(p, q);
+        unsigned width;
+        const auto kind = common(kind_of(p), rows_kind(q, width));
+        if( kind == num_kind::NONE || static_cast<unsigned>(p->list_length()) != width )
+            return(nullptr);
+        result = (kind == num_kind::INTS) ? dot_rows<int>(p, q) : dot_rows<double>(p, q);
+        break;
+    }
+    case idiom::VEC_MAT:
+    case idiom::MAT_MUL: {
+        const bool vector = (which == idiom::VEC_MAT);
+        unsigned inner, width;
+        auto kind = rows_kind(q, width);
+        if( vector ){
+            kind = common(kind, kind_of(p));
+            inner = kind == num_kind::NONE ? 0 : static_cast<unsigned>(p->list_length());
+        } else
+            kind = common(kind, rows_kind(p, inner));
+        const auto k = static_cast<unsigned>(q->list_length());
+        if( kind == num_kind::NONE || inner != k )
+            return(nullptr);
+        result = (kind == num_kind::INTS) ? times_matrix<int>(p, vector, q, k, width) :
+            times_matrix<double>(p, vector, q, k, width);
+        break;
+    }
+    default:
+        return(nullptr);
+    }
+    obj_unref(obj);
+    return(result);
+}
+
+    /*
+     * trans of a matrix whose rows are all unboxed, of one kind and
+     *	length.  The elements are copied a square tile at a time, so
+     *	the rows being read and the columns being written both stay in
+     *	the cache, into one store which the rows of the result view
+     *	slices of.  Fewer than VECTOR_MIN rows would give short rows,
+     *	which are kept as cons cells, so those are left to do_trans().
+     */
+
+/// Rows and columns of the tiles trans copies
+static constexpr unsigned TRANS_BLOCK = 32;
+
+/// out = the n rows, each len long, transposed
+template <typename ELEM>
+static void
+transpose(const std::vector<const ELEM *> &rows, unsigned len, ELEM *out)
+{
+    const auto n = static_cast<unsigned>(rows.size());
+    for( unsigned i0 = 0; i0 < n; i0 += TRANS_BLOCK ){
+        const unsigned i1 = std::min(n, i0 + TRANS_BLOCK);
+        for( unsigned j0 = 0; j0 < len; j0 += TRANS_BLOCK ){
+            const unsigned j1 = std::min(len, j0 + TRANS_BLOCK);
+            for( unsigned i = i0; i < i1; ++i ){
+                const ELEM *row = rows[i];
+                for( unsigned j = j0; j < j1; ++j )
+                    out[static_cast<size_t>(j) * n + i] = row[j];
+            }
+        }
+    }
+}
+
+/// The transpose of m, n rows of len ELEMs, as len views of one store
+template <typename ELEM>
+static live_obj_ptr
+trans_of(obj_ptr m, unsigned n, unsigned len, store_kind kind)
+{
+    std::vector<const ELEM *> rows;
+    rows.reserve(n);
+    for( list_iter it{m}; !it.done(); it.next() ){
+        auto row = it.elem();
+        rows.push_back(slots_of(row->vec_store(), static_cast<const ELEM *>(nullptr)) +
+                       row->vec_offset());
+    }
+    auto store = vector_store::create(n * len, kind);
+    store->length = n * len;
+    transpose(rows, len, slots_of(store, static_cast<const ELEM *>(nullptr)));
+    list_builder b{len};
+    for( unsigned j = 0; j < len; ++j ){
+        if( j > 0 )
+            store->add_ref();
+        b.push(obj_alloc(store, j * n, n));
+    }
+    return(b.finish());
+}
+
+obj_ptr
+vec_trans(live_obj_ptr obj)
+{
+    if( !obj->is_list() )
+        return(nullptr);
+    const auto n = static_cast<unsigned>(obj->list_length());
+    if( n < list_builder::VECTOR_MIN )
+        return(nullptr);
+    auto kind = store_kind::OBJECTS;
+    unsigned len = 0;
+    for( list_iter it{obj}; !it.done(); it.next() ){
+        auto row = it.elem();
+        if( !row->is_packed() )
+            return(nullptr);
+        const auto k = row->vec_store_as_is()->kind;
+        if( kind == store_kind::OBJECTS ){
+            kind = k;
+            len = row->vec_length();
+        } else if( k != kind || row->vec_length() != len )
+            return(nullptr);
+    }
+    if( static_cast<unsigned long long>(n) * len > UINT_MAX / sizeof(double) )
+        return(nullptr);
+    auto result = (kind == store_kind::INTS) ? trans_of<int>(obj, n, len, kind) :
+        trans_of<double>(obj, n, len, kind);
+    obj_unref(obj);
+    return(result);
+}
@@ -0,0 +1,16 @@
+#ifndef VECTOR_OPS_H
+#define VECTOR_OPS_H
+
+//vector_ops.cpp
+/// vec_insert()--!op or |op run straight over an unboxed vector, or null
+obj_ptr vec_insert(live_ast_ptr act, live_obj_ptr obj, bool binary);
+/// vec_map_form()--the trans, distl or distr of an &op@form composition, or null
+ast_ptr vec_map_form(live_ast_ptr act);
+/// vec_map_pair()--&op@form over unboxed vectors, or null
+obj_ptr vec_map_pair(live_ast_ptr map, live_ast_ptr form, live_obj_ptr obj);
+/// vec_idiom()--the 'V' node act's kernel run on obj, or null if it can't take obj
+obj_ptr vec_idiom(live_ast_ptr act, live_obj_ptr obj);
+/// vec_trans()--trans of rows which are all unboxed vectors of one kind, or null
+obj_ptr vec_trans(live_obj_ptr obj);
+
+#endif
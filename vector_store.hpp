@@ -0,0 +1,193 @@
+#ifndef VECTOR_STORE_HPP
+#define VECTOR_STORE_HPP
+
+#include <stddef.h>
+#include <new>
+#include "refcount.hpp"
+
+/// What the slots of a vector_store hold
+enum class store_kind : unsigned char {
+    /// Referenced objects
+    OBJECTS,
+    /// Unboxed ints
+    INTS,
+    /// Unboxed doubles
+    DOUBLES
+};
+
+/**
+ * The backing array of a T_VECTOR list.  Any number of T_VECTOR objects
+ *	may view a slice of the same store; the store counts those views
+ *	and owns one reference to each element it holds.
+ *
+ * A list made up entirely of ints, or entirely of floats, is kept
+ *	unboxed so the numeric kernels can run straight over the array.
+ *	Code that wants a list element as an object gets it from box(),
+ *	which makes the object on first use and keeps it in boxes[]
+ *	for as long as the store lives.  Threads applying a function in
+ *	parallel may box the same store at once, so boxes[] and its slots
+ *	are only ever filled in by compare-and-swap.
+ *
+ * iota makes a range: a store of ints whose slots are left untouched,
+ *	so that a big range costs no memory until something reads them.
+ *	The forms, selectors and distl work out a range's elements from
+ *	their positions instead; anything else gets the store through
+ *	object::vec_store(), which first writes the ints out with fill(),
+ *	and from then on the store is like any other.
+ */
+struct vector_store final {
+    /// Number of T_VECTOR objects viewing this store
+    unsigned refs = 1;
+    /// Slots filled in
+    unsigned length = 0;
+    /// Slots allocated
+    unsigned capacity;
+    /// What the slots hold
+    const store_kind kind;
+    /// Made in an application's arena, so it goes when the arena does
+    bool in_arena = false;
+    /// The ints 1, 2, ... up to length, not yet written out; see fill()
+    bool range = false;
+    union {
+        /// Lazily made objects for the slots of an unboxed store
+        obj_ptr * _Nullable boxes = nullptr;
+        /// Once dead, link in obj_unref()'s list of stores to empty
+        vector_store * _Nullable next_dead;
+    };
+
+    /// The element slots, which follow the header in the same block
+    obj_ptr *elems()
+    {
+        assert(kind == store_kind::OBJECTS);
+        return reinterpret_cast<obj_ptr *>(this + 1);
+    }
+
+    /// The slots of a store of unboxed ints
+    int *ints()
+    {
+        assert(kind == store_kind::INTS);
+        return reinterpret_cast<int *>(this + 1);
+    }
+
+    /// The slots of a store of unboxed doubles
+    double *doubles()
+    {
+        assert(kind == store_kind::DOUBLES);
+        return reinterpret_cast<double *>(this + 1);
+    }
+
+    /// Another view of this store is being made
+    void add_ref()
+    {
+        ref_inc(refs);
+    }
+
+    /// A view has gone; true if it was the last
+    bool drop_ref()
+    {
+        return ref_dec(refs) == 0;
+    }
+
+    /// true if only one view is left
+    bool unique() const
+    {
+        return ref_get(refs) == 1;
+    }
+
+    /// true unless the slots hold objects
+    bool is_packed() const
+    {
+        return kind != store_kind::OBJECTS;
+    }
+
+    /// true for a range whose ints haven't been written out
+    bool is_range() const
+    {
+        return __atomic_load_n(&range, __ATOMIC_ACQUIRE);
+    }
+
+    /// Write out a range's ints, if another thread hasn't; in obj.c
+    void fill();
+
+    /// Slot x as an object, not referenced for the caller
+    obj_ptr elem(unsigned x)
+    {
+        assert(x < length);
+        if( kind == store_kind::OBJECTS )
+            return elems()[x];
+        auto b = __atomic_load_n(&boxes, __ATOMIC_ACQUIRE);
+        if( b ){
+            if( auto p = __atomic_load_n(&b[x], __ATOMIC_ACQUIRE) )
+                return p;
+        }
+        return box(x);
+    }
+
+    /// Get a store with room for n elements of the given kind
+    static vector_store * _Nonnull create(unsigned n,
+                                          store_kind kind = store_kind::OBJECTS)
+    {
+        bool arena = false;
+        void *raw = block(sizeof(vector_store) + n * slot_size(kind), arena);
+        auto store = new (raw) vector_store{n, kind};
+        store->in_arena = arena;
+        return store;
+    }
+
+    /// Get a range of the ints 1 to n, written out only if they must be
+    static vector_store * _Nonnull create_range(unsigned n)
+    {
+        auto store = create(n, store_kind::INTS);
+        store->length = n;
+        store->range = true;
+        return store;
+    }
+
+    /// Release the memory of a store; the caller has dealt with the elements
+    static void destroy(vector_store * _Nonnull store)
+    {
+        const bool arena = store->in_arena;
+        if( !arena )
+            delete[] store->boxes;
+        store->~vector_store();
+        if( !arena )
+            ::operator delete(store);
+    }
+
+    /// Set up an empty boxes[] as big as the store, unless another thread has; in obj.c
+    void make_boxes();
+
+private:
+    explicit vector_store(unsigned n, store_kind k)
+    : capacity{n},
+    kind{k}
+    {
+    }
+
+    /// Bytes needed for one slot
+    static size_t slot_size(store_kind kind)
+    {
+        switch( kind ){
+        case store_kind::OBJECTS:
+            return sizeof(obj_ptr);
+        case store_kind::INTS:
+            return sizeof(int);
+        case store_kind::DOUBLES:
+            return sizeof(double);
+        }
+        return sizeof(double);
+    }
+
+    /// Make (and remember) the object for unboxed slot x; in obj.c
+    obj_ptr box(unsigned x);
+
+    /// Memory for a store, from the arena if one is open; in obj.c
+    static void * _Nonnull block(size_t bytes, bool &arena);
+};
+
+static_assert(sizeof(vector_store) % sizeof(double) == 0,
+              "vector_store header must keep its elements aligned");
+static_assert(sizeof(vector_store) % sizeof(obj_ptr) == 0,
+              "vector_store header must keep its elements aligned");
+
+#endif
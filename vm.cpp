@@ -0,0 +1,854 @@
+/*
+ * vm.cpp--compile function ASTs to bytecode, and run it
+ *
+ *	Each definition is compiled once, when it is defined, to a straight
+ *	run of instructions.  The VM keeps the object being worked on in an
+ *	accumulator: every function takes its argument from there and
+ *	leaves its result there, so a composition f@g is just g's code
+ *	followed by f's.  Objects which must wait--the argument while a
+ *	condition is tested, the elements of a construction so far--go on
+ *	a value stack.  A call of a user function pushes a frame on a
+ *	stack of its own rather than recursing in C, so how deep calls
+ *	may nest is up to depth_limit() rather than the C stack.
+ *
+ *	Dispatch is direct threaded where the compiler has computed goto;
+ *	each instruction carries the address of its handler.
+ */
+#include <stdio.h>
+#include <algorithm>
+#include <vector>
+#include "fpcommon.h"
+#include "vm.h"
+#include "yystype.h"
+#include "ast.hpp"
+#include "charfn.h"
+#include "depth.h"
+#include "exec.h"
+#include "memo.h"
+#include "misc.h"
+#include "obj.h"
+#include "object.hpp"
+#include "forms.hpp"
+#include "list_builder.hpp"
+#include "symtab_entry.hpp"
+#include "vector_ops.h"
+#include "vm_code.hpp"
+#include "y.tab.h"
+
+#if defined(__GNUC__)
+#define VM_THREADED 1
+#endif
+
+/// Run compiled code, or the tree walker
+static bool vm_on = true;
+
+/// Where to go back to when a called function is done
+struct vm_frame {
+    const vm_code * _Nonnull code;
+    const vm_insn * _Nonnull ret;
+    /// Pushed by BLOCK rather than a call
+    bool block;
+};
+
+/// Calls in progress, for every run() active on this thread
+static thread_local std::vector<vm_frame> frames;
+/// How many of those frames BLOCK pushed, which don't count as calls
+static thread_local size_t blocks = 0;
+/// Objects set aside by ARG, for every run() active on this thread
+static thread_local std::vector<obj_ptr> vals;
+
+/// Handlers by vm_op, once run() has told us where they are
+static const void * const * _Nullable handlers = nullptr;
+
+static live_obj_ptr run(const vm_code * _Nonnull code, int entry, live_obj_ptr acc);
+
+    /*
+     * Compiling.  Functions which a form applies over and over are
+     *	compiled after the body, each as a block ending in RET; the
+     *	instruction which applies one learns its offset at the end.
+     */
+namespace {
+struct compiler final {
+    vm_code &out;
+
+    /// What learns where a block starts: an instruction's a or b, or an entry
+    enum class slot { A, B, ENTRY };
+
+    /// A block yet to be compiled, and the operand to fill in with where
+    struct pending_block {
+        size_t insn;
+        slot where;
+        live_ast_ptr act;
+    };
+    std::vector<pending_block> pending;
+
+    explicit compiler(vm_code &c)
+    : out{c}
+    {
+    }
+
+    int here() const
+    {
+        return static_cast<int>(out.insns.size());
+    }
+
+    size_t emit(vm_op op)
+    {
+        out.insns.emplace_back(op);
+        return out.insns.size() - 1;
+    }
+
+    vm_insn &at(size_t x)
+    {
+        return out.insns[x];
+    }
+
+    /// Compile a function, then everything it needs
+    void program(live_ast_ptr act)
+    {
+        function(act);
+        emit(vm_op::RET);
+        while( !pending.empty() ){
+            auto block = pending.back();
+            pending.pop_back();
+            switch( block.where ){
+            case slot::A:
+                at(block.insn).a = here();
+                break;
+            case slot::B:
+                at(block.insn).b = here();
+                break;
+            case slot::ENTRY:
+                out.entries[block.insn].at = here();
+                break;
+            }
+            function(block.act);
+            emit(vm_op::RET);
+        }
+        tail_calls();
+    }
+
+    /// Where control really goes on to from x, past any JUMPs
+    size_t landing(size_t x)
+    {
+        while( at(x).op == vm_op::JUMP )
+            x = static_cast<size_t>(at(x).a);
+        return(x);
+    }
+
+        /*
+         * A CALL whose result is returned as it stands--the last step of
+         *	a composition, the end of either arm of a conditional--becomes
+         *	a TAILCALL, which reuses the caller's frame.  JUMPs to a RET
+         *	become RETs while we're at it.
+         */
+    void tail_calls()
+    {
+        for( size_t x = 0; x < out.insns.size(); ++x ){
+            auto &insn = at(x);
+            if( insn.op == vm_op::JUMP && at(landing(x)).op == vm_op::RET )
+                insn.op = vm_op::RET;
+            else if( insn.op == vm_op::CALL && at(landing(x + 1)).op == vm_op::RET )
+                insn.op = vm_op::TAILCALL;
+        }
+    }
+
+    /// Code to apply act to the accumulator
+    void function(live_ast_ptr act)
+    {
+        switch( act->tag ){
+        case 'U': {
+            auto x = emit(vm_op::CALL);
+            at(x).sym = act->val.YYsym;
+            return;
+        }
+        case 'i': {
+            auto x = emit(vm_op::INTRIN);
+            at(x).sym = act->val.YYsym;
+            at(x).fn = act->fn;
+            return;
+        }
+        case 'S': {
+            auto x = emit(vm_op::SEL);
+            at(x).a = act->val.YYint;
+            return;
+        }
+        case 'D': {
+            auto x = emit(vm_op::DROP);
+            at(x).a = act->val.YYint;
+            return;
+        }
+        case 'c': {
+            auto x = emit(vm_op::CHAR);
+            at(x).a = act->val.YYint;
+            return;
+        }
+        case '%': {
+            auto x = emit(vm_op::CONST);
+            at(x).obj[0] = act->val.YYobj;
+            return;
+        }
+        case '@':
+            composition(act);
+            return;
+        case '[':
+            construction(act);
+            return;
+        case '>':
+            conditional(act);
+            return;
+        case '&':
+            applied(vm_op::MAP, act->live_left());
+            return;
+        case '!':
+            applied(vm_op::RINSERT, act->live_left());
+            return;
+        case '|':
+            applied(vm_op::BINSERT, act->live_left());
+            at(out.insns.size() - 1).form = act;
+            return;
+        case 'W': {
+            auto x = emit(vm_op::LOOP);
+            pending.push_back({x, slot::A, act->live_left()});
+            pending.push_back({x, slot::B, act->live_right()});
+            return;
+        }
+        case 'P':
+            pipeline(act);
+            return;
+        case 'V': {
+            auto x = emit(vm_op::IDIOM);
+            at(x).act = act;
+            function(act->live_left());
+            at(x).a = here();
+            return;
+        }
+        default:
+            fatal_err("Undefined AST tag in vm_compile()");
+        }
+    }
+
+    /// A form applying fn, compiled as a block of its own
+    void applied(vm_op op, live_ast_ptr fn)
+    {
+        auto x = emit(op);
+        at(x).act = fn;
+        pending.push_back({x, slot::A, fn});
+    }
+
+    /// A pipeline; PIPE finds the blocks of the functions it applies by AST
+    void pipeline(live_ast_ptr act)
+    {
+        auto x = emit(vm_op::PIPE);
+        at(x).act = act;
+        at(x).a = static_cast<int>(out.entries.size());
+        auto block = [this](ast_ptr fn){
+            if( !fn )
+                return;
+            out.entries.push_back({fn, 0});
+            pending.push_back({out.entries.size() - 1, slot::ENTRY, static_cast<live_ast_ptr>(fn)});
+        };
+        for( ast_ptr stage = act->left; stage; stage = stage->right ){
+            block(stage->left);
+            block(stage->middle);
+        }
+        if( act->right && act->right->tag != 'i' )
+            block(act->right->left);
+        at(x).b = static_cast<int>(out.entries.size()) - at(x).a;
+    }
+
+    /// Where an operand of a fused binary function can come from, if it can
+    static bool operand(live_ast_ptr act)
+    {
+        switch( act->tag ){
+        case 'S':
+        case '%':
+            return(true);
+        case 'i':
+            return act->val.YYsym->sym_val.YYint == ID;
+        }
+        return(false);
+    }
+
+        /*
+         * a@b@...@z, which groups to the right.  The links are compiled
+         *	z first; some adjacent pairs have instructions of their own.
+         */
+    void composition(live_ast_ptr act)
+    {
+        std::vector<live_ast_ptr> links;	// '@' nodes
+        std::vector<live_ast_ptr> fns;
+        live_ast_ptr p = act;
+        while( p->tag == '@' ){
+            links.push_back(p);
+            fns.push_back(p->live_left());
+            p = p->live_right();
+        }
+        fns.push_back(p);
+
+        auto x = fns.size();
+        while( x > 0 ){
+            --x;
+            if( x > 0 && fused_char(fns[x - 1], fns[x]) ){
+                --x;
+                continue;
+            }
+            if( x > 0 ){
+                if( auto form = vec_map_form(links[x - 1]) ){
+                    assert(form == fns[x]);
+                    auto map = fns[x - 1];
+                    auto vmap = emit(vm_op::VMAP);
+                    at(vmap).act = map;
+                    at(vmap).form = form;
+                    function(fns[x]);
+                    function(map);
+                    at(vmap).a = here();
+                    --x;
+                    continue;
+                }
+            }
+            function(fns[x]);
+        }
+    }
+
+    /// op@[f,g] with f and g simple: one instruction, and no pair
+    bool fused_char(live_ast_ptr op, live_ast_ptr cons)
+    {
+        if( op->tag != 'c' || cons->tag != '[' )
+            return(false);
+        auto first = cons->live_left();
+        if( !first->right || first->live_right()->right )
+            return(false);
+        live_ast_ptr f[2] = { first->live_left(), first->live_right()->live_left() };
+        if( !operand(f[0]) || !operand(f[1]) )
+            return(false);
+
+        auto x = emit(vm_op::CHAR2);
+        auto &insn = at(x);
+        insn.c = op->val.YYint;
+        for( int y = 0; y < 2; ++y ){
+            switch( f[y]->tag ){
+            case 'S':
+                insn.from[y] = vm_from::SEL;
+                (y ? insn.b : insn.a) = f[y]->val.YYint;
+                break;
+            case '%':
+                insn.from[y] = vm_from::CONST;
+                insn.obj[y] = f[y]->val.YYobj;
+                break;
+            default:
+                insn.from[y] = vm_from::SELF;
+                break;
+            }
+        }
+        return(true);
+    }
+
+        /*
+         * [f1, ..., fn].  As in the tree walker, when all but one of the
+         *	functions are quick and that one can't print, those after the
+         *	slow one run first; LIST puts the results back in order.
+         */
+    void construction(live_ast_ptr act)
+    {
+        std::vector<live_ast_ptr> fns;
+        for( ast_ptr a = act->left; a; a = a->right )
+            fns.push_back(a->live_left());
+        const auto n = fns.size();
+
+        size_t slow = n;
+        for( size_t x = 0; x < n; ++x ){
+            if( quick_form(fns[x]) )
+                continue;
+            if( slow != n ){
+                forked(act, fns);
+                return;
+            }
+            slow = x;
+        }
+        std::vector<live_ast_ptr> order;
+        int rot = 0;
+        if( slow < n - 1 && !may_print(fns[slow]) ){
+            order.insert(order.end(), fns.begin() + static_cast<long>(slow) + 1, fns.end());
+            order.insert(order.end(), fns.begin(), fns.begin() + static_cast<long>(slow) + 1);
+            rot = static_cast<int>(n - 1 - slow);
+        } else
+            order = fns;
+
+        std::vector<size_t> keeps;
+        for( size_t x = 0; x + 1 < n; ++x ){
+            emit(vm_op::ARG);
+            function(order[x]);
+            auto keep = emit(vm_op::KEEP);
+            at(keep).a = static_cast<int>(x);
+            keeps.push_back(keep);
+        }
+        function(order[n - 1]);
+        auto list = emit(vm_op::LIST);
+        at(list).a = static_cast<int>(n);
+        at(list).b = rot;
+        for( auto keep: keeps )
+            at(keep).b = here();
+    }
+
+        /*
+         * A construction with two or more slow functions.  Each function
+         *	gets a block of its own, for FORK to run them all at once.  If
+         *	it doesn't, the code after it runs them in turn, the slow ones
+         *	by BLOCK, so none is compiled twice.
+         */
+    void forked(live_ast_ptr act, const std::vector<live_ast_ptr> &fns)
+    {
+        const auto n = fns.size();
+        auto fork = emit(vm_op::FORK);
+        const int first = static_cast<int>(out.entries.size());
+        at(fork).act = act;
+        at(fork).a = first;
+        at(fork).b = static_cast<int>(n);
+        for( auto fn: fns ){
+            out.entries.push_back({fn, 0});
+            pending.push_back({out.entries.size() - 1, slot::ENTRY, fn});
+        }
+
+        std::vector<size_t> keeps;
+        for( size_t x = 0; x < n; ++x ){
+            const bool last = (x + 1 == n);
+            if( !last )
+                emit(vm_op::ARG);
+            if( quick_form(fns[x]) )
+                function(fns[x]);
+            else {
+                auto block = emit(vm_op::BLOCK);
+                at(block).a = first + static_cast<int>(x);
+            }
+            if( !last ){
+                auto keep = emit(vm_op::KEEP);
+                at(keep).a = static_cast<int>(x);
+                keeps.push_back(keep);
+            }
+        }
+        auto list = emit(vm_op::LIST);
+        at(list).a = static_cast<int>(n);
+        for( auto keep: keeps )
+            at(keep).b = here();
+        at(fork).c = here();
+    }
+
+    /// (p -> f ; g)
+    void conditional(live_ast_ptr act)
+    {
+        emit(vm_op::ARG);
+        function(act->live_left());
+        auto test = emit(vm_op::TEST);
+        function(act->live_middle());
+        auto jump = emit(vm_op::JUMP);
+        at(test).a = here();
+        function(act->live_right());
+        at(test).b = here();
+        at(jump).a = here();
+    }
+};
+}
+
+/// A call of a function whose results are kept, run in a run() of its own
+static live_obj_ptr
+memo_call(live_sym_ptr def, live_obj_ptr obj)
+{
+    if( auto p = memo_lookup(def, obj) ){
+        obj_unref(obj);
+        return static_cast<live_obj_ptr>(p);
+    }
+    obj->inc_ref();
+    auto result = run(def->code(), 0, obj);
+    memo_store(def, obj, result);
+    obj_unref(obj);
+    return(result);
+}
+
+/// Fill in the handler of each instruction, for threaded dispatch
+static void
+link(vm_code &code)
+{
+#ifdef VM_THREADED
+    if( !handlers )
+        run(nullptr, 0, undefined());
+    for( auto &insn: code.insns )
+        insn.handler = handlers[static_cast<int>(insn.op)];
+#else
+    (void)code;
+#endif
+}
+
+vm_code *
+vm_compile(live_ast_ptr act)
+{
+    auto code = new vm_code;
+    compiler{*code}.program(act);
+    link(*code);
+    return(code);
+}
+
+void
+vm_free(vm_code * _Nullable code)
+{
+    delete code;
+}
+
+/// Drop the top n objects of the value stack
+static void
+drop_vals(size_t n)
+{
+    while( n-- > 0 ){
+        obj_unref(vals.back());
+        vals.pop_back();
+    }
+}
+
+/// One operand of CHAR2, referenced for the caller
+static live_obj_ptr
+operand(const vm_insn &insn, int y, live_obj_ptr acc)
+{
+    switch( insn.from[y] ){
+    case vm_from::SELF:
+        acc->inc_ref();
+        return(acc);
+    case vm_from::SEL:
+        acc->inc_ref();
+        return do_select(y ? insn.b : insn.a, acc);
+    case vm_from::CONST:
+        break;
+    }
+    auto p = static_cast<live_obj_ptr>(insn.obj[y]);
+    p->inc_ref();
+    return(p);
+}
+
+#ifdef VM_THREADED
+#define OP(name)	op_##name:
+#define DISPATCH()	goto *pc->handler
+#else
+#define OP(name)	case vm_op::name:
+#define DISPATCH()	continue
+#endif
+#define NEXT()		{ ++pc; DISPATCH(); }
+#define JUMP_TO(x)	{ pc = code->insns.data() + (x); DISPATCH(); }
+
+    /*
+     * Apply the code starting at entry to acc.  Called with no code, just
+     *	tells link() where the handlers are.
+     */
+static live_obj_ptr
+run(const vm_code * _Nullable code, int entry, live_obj_ptr acc)
+{
+#ifdef VM_THREADED
+    static const void * const labels[] = {
+        &&op_INTRIN, &&op_SEL, &&op_DROP, &&op_CHAR, &&op_CHAR2, &&op_CONST,
+        &&op_CALL, &&op_TAILCALL, &&op_RET, &&op_ARG, &&op_KEEP, &&op_LIST, &&op_TEST,
+        &&op_JUMP, &&op_VMAP, &&op_IDIOM, &&op_MAP, &&op_RINSERT, &&op_BINSERT,
+        &&op_LOOP, &&op_PIPE, &&op_BLOCK, &&op_FORK
+    };
+    if( !code ){
+        handlers = labels;
+        return(acc);
+    }
+#endif
+    assert(code);
+    if( stack_exhausted() )
+        return too_deep(acc);
+    const size_t base = frames.size();
+    const vm_insn *pc = code->insns.data() + entry;
+
+#ifdef VM_THREADED
+    DISPATCH();
+#else
+    for(;;) switch( pc->op ){
+#endif
+
+    OP(INTRIN)
+        acc = pc->fn(acc);
+        NEXT();
+
+    OP(SEL)
+        acc = do_select(pc->a, acc);
+        NEXT();
+
+    OP(DROP)
+        acc = do_drop(pc->a, acc);
+        NEXT();
+
+    OP(CHAR) {
+        if( !acc->is_pair() ){
+            obj_unref(acc);
+            acc = undefined();
+            NEXT();
+        }
+        auto p = static_cast<live_obj_ptr>(acc->car());
+        auto q = static_cast<live_obj_ptr>(acc->cadr());
+        auto result = charfn(pc->a, p, q);
+        obj_unref(acc);
+        acc = result;
+        NEXT();
+    }
+
+	// op@[f,g] where f and g are selectors, constants or id
+    OP(CHAR2) {
+        if( acc->is_undef() )
+            NEXT();
+        auto p = operand(*pc, 0, acc);
+        auto q = operand(*pc, 1, acc);
+        obj_unref(acc);
+        if( p->is_undef() || q->is_undef() )
+            acc = undefined();
+        else
+            acc = charfn(pc->c, p, q);
+        obj_unref(p);
+        obj_unref(q);
+        NEXT();
+    }
+
+    OP(CONST) {
+        if( acc->is_undef() )
+            NEXT();
+        obj_unref(acc);
+        auto p = static_cast<live_obj_ptr>(pc->obj[0]);
+        p->inc_ref();
+        acc = p;
+        NEXT();
+    }
+
+    OP(CALL) {
+        auto def = static_cast<live_sym_ptr>(pc->sym);
+        if( !def->is_defined() ){
+            printf("%s: undefined\n",def->sym_pname.c_str());
+            obj_unref(acc);
+            acc = undefined();
+            NEXT();
+        }
+        if( def->sym_memo ){
+            acc = memo_call(def, acc);
+            NEXT();
+        }
+        if( frames.size() - blocks >= depth_limit() || stack_exhausted() ){
+            acc = too_deep(acc);
+            NEXT();
+        }
+        frames.push_back({code, pc + 1, false});
+        code = def->code();
+        JUMP_TO(0);
+    }
+
+	// A CALL with nothing left to do after it; the callee returns for us
+    OP(TAILCALL) {
+        auto def = static_cast<live_sym_ptr>(pc->sym);
+        if( !def->is_defined() ){
+            printf("%s: undefined\n",def->sym_pname.c_str());
+            obj_unref(acc);
+            acc = undefined();
+            NEXT();
+        }
+        if( def->sym_memo ){
+            acc = memo_call(def, acc);
+            NEXT();
+        }
+	    // A loop of tail calls never passes run()'s check again; this
+	    // is how an interrupt stops it while par.cpp's threads are busy
+        if( stack_exhausted() ){
+            acc = too_deep(acc);
+            NEXT();
+        }
+        code = def->code();
+        JUMP_TO(0);
+    }
+
+    OP(RET) {
+        if( frames.size() == base )
+            return(acc);
+        auto frame = frames.back();
+        frames.pop_back();
+        if( frame.block )
+            --blocks;
+        code = frame.code;
+        pc = frame.ret;
+        DISPATCH();
+    }
+
+	// Set aside a copy of the argument for later
+    OP(ARG)
+        acc->inc_ref();
+        vals.push_back(acc);
+        NEXT();
+
+	// A member of a construction is done; a is how many before it
+    OP(KEEP) {
+        auto x = static_cast<live_obj_ptr>(vals.back());
+        if( acc->is_undef() ){
+            obj_unref(x);
+            vals.pop_back();
+            drop_vals(static_cast<size_t>(pc->a));
+            JUMP_TO(pc->b);
+        }
+        vals.back() = acc;
+        acc = x;
+        NEXT();
+    }
+
+	// The last member is done; make the list, turned b places
+    OP(LIST) {
+        const auto n = static_cast<size_t>(pc->a);
+        if( acc->is_undef() ){
+            drop_vals(n - 1);
+            NEXT();
+        }
+        vals.push_back(acc);
+        const auto first = vals.size() - n;
+        const auto rot = static_cast<size_t>(pc->b);
+        list_builder b{static_cast<unsigned>(n)};
+        for( size_t x = rot; x < n; ++x )
+            b.push(static_cast<live_obj_ptr>(vals[first + x]));
+        for( size_t x = 0; x < rot; ++x )
+            b.push(static_cast<live_obj_ptr>(vals[first + x]));
+        vals.resize(first);
+        acc = b.finish();
+        NEXT();
+    }
+
+	// A condition has been worked out; on to its a (false) or b (done)
+    OP(TEST) {
+        auto x = static_cast<live_obj_ptr>(vals.back());
+        vals.pop_back();
+        if( acc->is_undef() ){
+            obj_unref(x);
+            JUMP_TO(pc->b);
+        }
+        if( !acc->is_bool() ){
+            obj_unref(x);
+            obj_unref(acc);
+            acc = undefined();
+            JUMP_TO(pc->b);
+        }
+        const bool truth = acc->bool_val();
+        obj_unref(acc);
+        acc = x;
+        if( !truth )
+            JUMP_TO(pc->a);
+        NEXT();
+    }
+
+    OP(JUMP)
+        JUMP_TO(pc->a);
+
+	// &op@trans and friends over unboxed vectors; skip to a if so
+    OP(VMAP) {
+        auto map = static_cast<live_ast_ptr>(pc->act);
+        auto form = static_cast<live_ast_ptr>(pc->form);
+        if( auto p = vec_map_pair(map, form, acc) ){
+            acc = static_cast<live_obj_ptr>(p);
+            JUMP_TO(pc->a);
+        }
+        NEXT();
+    }
+
+	// Linear algebra on a native kernel; skip to a if it took acc
+    OP(IDIOM) {
+        if( auto p = vec_idiom(static_cast<live_ast_ptr>(pc->act), acc) ){
+            acc = static_cast<live_obj_ptr>(p);
+            JUMP_TO(pc->a);
+        }
+        NEXT();
+    }
+
+    OP(MAP) {
+        const int fn = pc->a;
+        acc = form_map(static_cast<live_ast_ptr>(pc->act), acc,
+                       [code, fn](live_obj_ptr x){ return run(code, fn, x); });
+        NEXT();
+    }
+
+    OP(RINSERT) {
+        const int fn = pc->a;
+        acc = form_rinsert(static_cast<live_ast_ptr>(pc->act), acc,
+                           [code, fn](live_obj_ptr x){ return run(code, fn, x); });
+        NEXT();
+    }
+
+    OP(BINSERT) {
+        const int fn = pc->a;
+        acc = form_binsert(static_cast<live_ast_ptr>(pc->form), acc,
+                           [code, fn](live_obj_ptr x){ return run(code, fn, x); });
+        NEXT();
+    }
+
+    OP(LOOP) {
+        const int test = pc->a;
+        const int body = pc->b;
+        acc = form_while(acc,
+                         [code, test](live_obj_ptr x){ return run(code, test, x); },
+                         [code, body](live_obj_ptr x){ return run(code, body, x); });
+        NEXT();
+    }
+
+	// A pipeline; its functions are entries a to a + b - 1
+    OP(PIPE) {
+        const auto first = code->entries.data() + pc->a;
+        const auto last = first + pc->b;
+        acc = form_pipeline(static_cast<live_ast_ptr>(pc->act), acc,
+                            [code, first, last](live_ast_ptr fn, live_obj_ptr x){
+                                auto e = std::find_if(first, last,
+                                                      [fn](const vm_entry &y){ return y.fn == fn; });
+                                assert(e != last);
+                                return run(code, e->at, x);
+                            });
+        NEXT();
+    }
+
+	// Run entry a's block, returning here as from a call
+    OP(BLOCK)
+        frames.push_back({code, pc + 1, true});
+        ++blocks;
+        JUMP_TO(code->entries[static_cast<size_t>(pc->a)].at);
+
+	// A construction of the b functions from entry a; on to c if par.cpp runs them
+    OP(FORK) {
+        auto cons = static_cast<live_ast_ptr>(pc->act);
+        const auto size = par_fork(cons, acc);
+        if( !size )
+            NEXT();
+        const auto first = code->entries.data() + pc->a;
+        acc = form_par_construct(cons, static_cast<unsigned>(pc->b), size, acc,
+                                 [code, first](unsigned x, live_obj_ptr p){
+                                     return run(code, first[x].at, p);
+                                 });
+        JUMP_TO(pc->c);
+    }
+
+#ifndef VM_THREADED
+    }
+#endif
+}
+
+live_obj_ptr
+vm_application(live_ast_ptr act, live_obj_ptr obj)
+{
+    depth_reset();
+    if( !vm_on )
+        return execute(act, obj);
+    auto code = vm_compile(act);
+    auto result = run(code, 0, obj);
+    vm_free(code);
+    return(result);
+}
+
+void
+vm_toggle(void)
+{
+    vm_on = !vm_on;
+    printf("Bytecode VM %s\n", vm_on ? "on" : "off");
+}
+
+void
+vm_reset(void)
+{
+    frames.clear();
+    blocks = 0;
+    vals.clear();
+}
@@ -0,0 +1,15 @@
+#ifndef VM_H
+#define VM_H
+
+/// vm_compile()--compile a function to bytecode
+struct vm_code * _Nonnull vm_compile(live_ast_ptr act);
+/// vm_free()--throw away compiled code
+void vm_free(struct vm_code * _Nullable code);
+/// vm_application()--apply a function to an object, with the VM if it's on
+live_obj_ptr vm_application(live_ast_ptr act, live_obj_ptr obj);
+/// vm_toggle()--switch between the VM and the tree walker
+void vm_toggle(void);
+/// vm_reset()--forget calls cut short by an interrupt
+void vm_reset(void);
+
+#endif
@@ -0,0 +1,91 @@
+#ifndef VM_CODE_HPP
+#define VM_CODE_HPP
+
+#include <vector>
+
+/// Bytecode operations; vm.cpp says what each one does
+enum class vm_op : unsigned char {
+    INTRIN,
+    SEL,
+    DROP,
+    CHAR,
+    CHAR2,
+    CONST,
+    CALL,
+    TAILCALL,
+    RET,
+    ARG,
+    KEEP,
+    LIST,
+    TEST,
+    JUMP,
+    VMAP,
+    IDIOM,
+    MAP,
+    RINSERT,
+    BINSERT,
+    LOOP,
+    PIPE,
+    BLOCK,
+    FORK
+};
+
+/// Where a fused binary function (CHAR2) gets one of its operands
+enum class vm_from : unsigned char {
+    /// The argument itself
+    SELF,
+    /// A selector applied to the argument
+    SEL,
+    /// A constant
+    CONST
+};
+
+/// One instruction
+struct vm_insn final {
+    /// Where a threaded dispatch goes for this instruction
+    const void * _Nullable handler = nullptr;
+    vm_op op;
+    /// CHAR2's operands
+    vm_from from[2] = {};
+    /// Selector, charfn op, count or code offset
+    int a = 0;
+    /// Second count or code offset; CHAR2's selectors are in a and b
+    int b = 0;
+    /// CHAR2's charfn op, or where FORK goes on to
+    int c = 0;
+    /// The function (for MAP and the inserts), map (for VMAP), idiom, pipeline or construction
+    ast_ptr act = nullptr;
+    /// VMAP's trans/distl/distr, or BINSERT's |
+    ast_ptr form = nullptr;
+    /// The function CALLed, or the intrinsic
+    sym_ptr sym = nullptr;
+    /// What runs INTRIN's intrinsic
+    intrinsic_fn fn = nullptr;
+    /// CONST's object, or CHAR2's constant operands; the AST owns them
+    obj_ptr obj[2] = {};
+
+    explicit vm_insn(vm_op o)
+    : op{o}
+    {
+    }
+};
+
+/// A function a pipeline or FORK applies, and where its block starts
+struct vm_entry final {
+    ast_ptr fn;
+    int at;
+};
+
+/**
+ * A function compiled to bytecode.  The body starts at insns[0]; the
+ *	functions that forms such as & apply over and over follow it, each
+ *	ending in a RET of its own.  The code borrows objects and AST nodes
+ *	from the tree it was compiled from, so must go before that does.
+ */
+struct vm_code final {
+    std::vector<vm_insn> insns;
+    /// The functions of the pipelines, which PIPE looks up by AST, and of FORKs
+    std::vector<vm_entry> entries;
+};
+
+#endif